@@ -0,0 +1,479 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "date.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PFMS_HAVE_SSE2 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only view of a whole file: memory-mapped where available, otherwise
+// read into memory in one go.
+class MappedFile {
+private:
+    const char* bytes;
+    size_t length;
+    bool opened;
+    std::vector<char> fallback;
+#ifndef _WIN32
+    void* mapping;
+#endif
+
+public:
+    explicit MappedFile(const std::string& path) : bytes(nullptr), length(0), opened(false) {
+#ifndef _WIN32
+        mapping = nullptr;
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+                void* p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    ::madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                    mapping = p;
+                    bytes = static_cast<const char*>(p);
+                    length = static_cast<size_t>(st.st_size);
+                }
+            }
+            ::close(fd);
+            if (mapping) {
+                opened = true;
+                return;
+            }
+        }
+#endif
+        std::ifstream file(path, std::ios::binary);
+        if (file.is_open()) {
+            opened = true;
+            fallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            bytes = fallback.data();
+            length = fallback.size();
+        }
+    }
+
+    ~MappedFile() {
+#ifndef _WIN32
+        if (mapping) ::munmap(mapping, length);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const {
+        return opened;
+    }
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+};
+
+#ifdef PFMS_HAVE_SSE2
+// Index of the lowest set bit of a non-zero mask
+inline unsigned lowestSetBit(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+#endif
+
+// Finds the next delimiter or newline, 16 bytes at a time with SSE2
+inline const char* findFieldEnd(const char* p, const char* end, char delimiter) {
+#ifdef PFMS_HAVE_SSE2
+    const __m128i delim = _mm_set1_epi8(delimiter);
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, delim), _mm_cmpeq_epi8(chunk, newline)));
+        if (mask != 0) {
+            return p + lowestSetBit(static_cast<unsigned>(mask));
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && *p != delimiter && *p != '\n') p++;
+    return p;
+}
+
+inline const char* findLineEnd(const char* p, const char* end) {
+    const void* nl = std::memchr(p, '\n', static_cast<size_t>(end - p));
+    return nl ? static_cast<const char*>(nl) : end;
+}
+
+enum class DateOrder {
+    DMY,
+    MDY,
+    YMD
+};
+
+// Which columns hold what, for delimited bank exports
+struct ImportSpec {
+    static const int MAX_COLUMNS = 32;
+
+    char delimiter = ',';
+    bool hasHeader = true;
+    int dateColumn = 0;
+    int descriptionColumn = 1;
+    int amountColumn = 2;
+    int categoryColumn = -1;  // -1 = assign categories automatically
+    DateOrder dateOrder = DateOrder::DMY;
+    bool negativeIsExpense = true;  // otherwise every row is an expense
+
+    // "date=0,desc=1,amount=2,category=3,delim=;,order=ymd,header=0,sign=0"
+    bool parse(const std::string& text) {
+        std::istringstream in(text);
+        std::string item;
+        while (std::getline(in, item, ',')) {
+            size_t eq = item.find('=');
+            if (eq == std::string::npos) return false;
+            std::string key = item.substr(0, eq);
+            std::string value = item.substr(eq + 1);
+            if (key == "delim") {
+                if (value == "tab") delimiter = '\t';
+                else if (value == "semicolon") delimiter = ';';
+                else if (value.size() == 1) delimiter = value[0];
+                else return false;
+            } else if (key == "order") {
+                if (value == "dmy") dateOrder = DateOrder::DMY;
+                else if (value == "mdy") dateOrder = DateOrder::MDY;
+                else if (value == "ymd") dateOrder = DateOrder::YMD;
+                else return false;
+            } else {
+                int number = std::atoi(value.c_str());
+                if ((key == "date" || key == "desc" || key == "amount" || key == "category") &&
+                    (number < (key == "category" ? -1 : 0) || number >= MAX_COLUMNS)) {
+                    return false;
+                }
+                if (key == "date") dateColumn = number;
+                else if (key == "desc") descriptionColumn = number;
+                else if (key == "amount") amountColumn = number;
+                else if (key == "category") categoryColumn = number;
+                else if (key == "header") hasHeader = number != 0;
+                else if (key == "sign") negativeIsExpense = number != 0;
+                else return false;
+            }
+        }
+        return true;
+    }
+};
+
+struct ImportedRow {
+    Date date;
+    double amount;  // negative = money going out
+    std::string description;
+    std::string category;  // empty when the file has no category column
+
+    ImportedRow() : date(1, 1, 1970), amount(0.0) {}
+};
+
+struct ImportResult {
+    std::vector<ImportedRow> rows;
+    size_t skipped = 0;
+    bool opened = false;
+};
+
+namespace import_detail {
+
+inline void trim(const char*& b, const char*& e) {
+    while (b < e && (*b == ' ' || *b == '\t' || *b == '\r' || *b == '"')) b++;
+    while (e > b && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r' || e[-1] == '"')) e--;
+}
+
+// A currency symbol ("$", "£", "€", "₹", "¥", "Rs." or "Rs") and the spaces after it
+inline void skipSymbol(const char*& p, const char* e) {
+    static const char* const symbols[] = {"$", "\xC2\xA3", "\xE2\x82\xAC", "\xE2\x82\xB9", "\xC2\xA5", "Rs.", "Rs"};
+    for (const char* symbol : symbols) {
+        size_t length = std::strlen(symbol);
+        if (static_cast<size_t>(e - p) >= length && std::memcmp(p, symbol, length) == 0) {
+            p += length;
+            while (p < e && *p == ' ') p++;
+            return;
+        }
+    }
+}
+
+// Accepts "1234.50", "-1,234.50", "+12", "(12.00)", "-$5", "$-5" and
+// "1,00,000.00": one sign or a pair of parentheses, an optional currency
+// symbol, then digits grouped in threes (or in twos before the last three)
+// and an optional fraction. Anything else, e.g. "12abc34", "1.234,56" or
+// "1.2.3", is rejected so the row is skipped.
+inline bool parseAmount(const char* b, const char* e, double& value) {
+    trim(b, e);
+    bool negative = false;
+    bool hasSign = false;
+    if (b < e && *b == '(' && e[-1] == ')') {
+        negative = true;
+        hasSign = true;
+        b++;
+        e--;
+    }
+    const char* p = b;
+    auto readSign = [&]() {
+        if (!hasSign && p < e && (*p == '-' || *p == '+')) {
+            negative = *p == '-';
+            hasSign = true;
+            p++;
+        }
+    };
+    readSign();
+    skipSymbol(p, e);
+    readSign();
+
+    char digits[64];
+    size_t n = 0;
+    int group = 0;  // digits since the last separator
+    int groups = 0;
+    int first = 0;
+    bool middleThrees = true;
+    bool middleTwos = true;
+    for (; p < e && ((*p >= '0' && *p <= '9') || *p == ','); p++) {
+        if (*p == ',') {
+            if (group == 0) return false;
+            if (groups == 0) {
+                first = group;
+            } else {
+                middleThrees = middleThrees && group == 3;
+                middleTwos = middleTwos && group == 2;
+            }
+            groups++;
+            group = 0;
+            continue;
+        }
+        if (n + 1 >= sizeof(digits)) return false;
+        digits[n++] = *p;
+        group++;
+    }
+    if (n == 0) return false;
+    if (groups > 0 && (group != 3 || !((middleThrees && first <= 3) || (middleTwos && first <= 2)))) {
+        return false;
+    }
+    if (p < e && *p == '.') {
+        size_t point = n;
+        digits[n++] = *p++;
+        for (; p < e && *p >= '0' && *p <= '9'; p++) {
+            if (n + 1 >= sizeof(digits)) return false;
+            digits[n++] = *p;
+        }
+        if (n == point + 1) return false;
+    }
+    if (p != e) return false;
+    auto res = std::from_chars(digits, digits + n, value);
+    if (res.ec != std::errc() || res.ptr != digits + n) return false;
+    if (negative) value = -value;
+    return true;
+}
+
+// Three numbers separated by anything, or a compact YYYYMMDD in YMD order
+inline bool parseDate(const char* b, const char* e, DateOrder order, Date& date) {
+    trim(b, e);
+    int parts[3] = {0, 0, 0};
+    int count = 0;
+    const char* p = b;
+    if (order == DateOrder::YMD && e - b >= 8 && std::all_of(b, b + 8, [](char c) { return c >= '0' && c <= '9'; })) {
+        std::from_chars(b, b + 4, parts[0]);
+        std::from_chars(b + 4, b + 6, parts[1]);
+        std::from_chars(b + 6, b + 8, parts[2]);
+        date = Date(parts[2], parts[1], parts[0]);
+        return date.isValid();
+    }
+    while (p < e && count < 3) {
+        while (p < e && (*p < '0' || *p > '9')) p++;
+        if (p >= e) break;
+        auto res = std::from_chars(p, e, parts[count]);
+        p = res.ptr;
+        count++;
+    }
+    if (count != 3) return false;
+    switch (order) {
+        case DateOrder::DMY: date = Date(parts[0], parts[1], parts[2]); break;
+        case DateOrder::MDY: date = Date(parts[1], parts[0], parts[2]); break;
+        case DateOrder::YMD: date = Date(parts[2], parts[1], parts[0]); break;
+    }
+    return date.isValid();
+}
+
+// Parses the complete lines in [begin, end)
+inline void parseLines(const char* begin, const char* end, const ImportSpec& spec,
+                       std::vector<ImportedRow>& rows, size_t& skipped) {
+    int lastColumn = std::max(std::max(spec.dateColumn, spec.descriptionColumn),
+                              std::max(spec.amountColumn, spec.categoryColumn));
+    const char* fieldBegin[ImportSpec::MAX_COLUMNS];
+    const char* fieldEnd[ImportSpec::MAX_COLUMNS];
+
+    const char* p = begin;
+    while (p < end) {
+        const char* lineEnd = findLineEnd(p, end);
+        int column = 0;
+        const char* f = p;
+        while (column <= lastColumn) {
+            const char* fe;
+            if (f < lineEnd && *f == '"') {
+                // Quoted field: the delimiter may appear inside the quotes
+                const void* close = std::memchr(f + 1, '"', static_cast<size_t>(lineEnd - f - 1));
+                const char* after = close ? static_cast<const char*>(close) + 1 : lineEnd;
+                fe = findFieldEnd(after, lineEnd, spec.delimiter);
+            } else {
+                fe = findFieldEnd(f, lineEnd, spec.delimiter);
+            }
+            fieldBegin[column] = f;
+            fieldEnd[column] = fe;
+            column++;
+            if (fe >= lineEnd) break;
+            f = fe + 1;
+        }
+
+        if (column > lastColumn) {
+            ImportedRow row;
+            bool ok = parseDate(fieldBegin[spec.dateColumn], fieldEnd[spec.dateColumn], spec.dateOrder, row.date) &&
+                      parseAmount(fieldBegin[spec.amountColumn], fieldEnd[spec.amountColumn], row.amount);
+            if (ok) {
+                if (!spec.negativeIsExpense) row.amount = -std::abs(row.amount);
+                const char* db = fieldBegin[spec.descriptionColumn];
+                const char* de = fieldEnd[spec.descriptionColumn];
+                trim(db, de);
+                row.description.assign(db, de);
+                if (spec.categoryColumn >= 0) {
+                    const char* cb = fieldBegin[spec.categoryColumn];
+                    const char* ce = fieldEnd[spec.categoryColumn];
+                    trim(cb, ce);
+                    row.category.assign(cb, ce);
+                }
+                rows.push_back(std::move(row));
+            } else {
+                skipped++;
+            }
+        } else if (lineEnd - p > 1) {
+            skipped++;
+        }
+        p = lineEnd + 1;
+    }
+}
+
+// Value of an OFX/SGML tag inside [b, e): text after <TAG> up to the next '<' or newline
+inline bool ofxTag(const char* b, const char* e, const char* tag, const char*& vb, const char*& ve) {
+    std::string open = std::string("<") + tag + ">";
+    const char* at = std::search(b, e, open.begin(), open.end());
+    if (at == e) return false;
+    vb = at + open.size();
+    ve = vb;
+    while (ve < e && *ve != '<' && *ve != '\n' && *ve != '\r') ve++;
+    return true;
+}
+
+} // namespace import_detail
+
+// Splits a delimited export into line-aligned chunks and parses them in
+// parallel. Rows come back in file order. Quoted fields must not contain
+// line breaks.
+inline ImportResult parseDelimited(const MappedFile& file, const ImportSpec& spec, unsigned threads = 0) {
+    ImportResult result;
+    result.opened = file.isOpen();
+    if (!file.isOpen() || file.size() == 0) {
+        return result;
+    }
+
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+    if (spec.hasHeader) {
+        begin = std::min(end, findLineEnd(begin, end) + 1);
+    }
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // Small files are not worth the thread start-up
+    size_t minChunk = 1 << 20;
+    size_t bytes = static_cast<size_t>(end - begin);
+    threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, bytes / minChunk)));
+
+    std::vector<const char*> cuts(threads + 1, end);
+    cuts[0] = begin;
+    for (unsigned i = 1; i < threads; i++) {
+        const char* guess = begin + bytes * i / threads;
+        cuts[i] = std::max(cuts[i - 1], std::min(end, findLineEnd(guess, end) + 1));
+    }
+
+    std::vector<std::vector<ImportedRow>> parts(threads);
+    std::vector<size_t> skipped(threads, 0);
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; i++) {
+        workers.emplace_back([&, i]() {
+            import_detail::parseLines(cuts[i], cuts[i + 1], spec, parts[i], skipped[i]);
+        });
+    }
+    import_detail::parseLines(cuts[0], cuts[1], spec, parts[0], skipped[0]);
+    for (auto& w : workers) {
+        w.join();
+    }
+
+    size_t total = 0;
+    for (const auto& part : parts) total += part.size();
+    result.rows.reserve(total);
+    for (unsigned i = 0; i < threads; i++) {
+        std::move(parts[i].begin(), parts[i].end(), std::back_inserter(result.rows));
+        result.skipped += skipped[i];
+    }
+    return result;
+}
+
+// OFX statements: one row per <STMTTRN> block (TRNAMT, DTPOSTED, NAME or MEMO)
+inline ImportResult parseOfx(const MappedFile& file) {
+    ImportResult result;
+    result.opened = file.isOpen();
+    if (!file.isOpen()) {
+        return result;
+    }
+
+    const char* p = file.data();
+    const char* end = p + file.size();
+    const std::string open = "<STMTTRN>";
+    const std::string close = "</STMTTRN>";
+    while (true) {
+        const char* block = std::search(p, end, open.begin(), open.end());
+        if (block == end) break;
+        const char* blockEnd = std::search(block, end, close.begin(), close.end());
+
+        ImportedRow row;
+        const char *vb, *ve;
+        bool ok = import_detail::ofxTag(block, blockEnd, "TRNAMT", vb, ve) &&
+                  import_detail::parseAmount(vb, ve, row.amount) &&
+                  import_detail::ofxTag(block, blockEnd, "DTPOSTED", vb, ve) &&
+                  import_detail::parseDate(vb, ve, DateOrder::YMD, row.date);
+        if (ok) {
+            if (import_detail::ofxTag(block, blockEnd, "NAME", vb, ve) ||
+                import_detail::ofxTag(block, blockEnd, "MEMO", vb, ve)) {
+                import_detail::trim(vb, ve);
+                row.description.assign(vb, ve);
+            }
+            result.rows.push_back(std::move(row));
+        } else {
+            result.skipped++;
+        }
+        p = blockEnd == end ? end : blockEnd + close.size();
+    }
+    return result;
+}
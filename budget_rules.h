@@ -0,0 +1,183 @@
+#pragma once
+#include <algorithm>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "date.h"
+
+// Declarative budget and alert rules, evaluated incrementally against running
+// counters. Each insert only touches the rules that apply to its category; a
+// monthly cap is one counter lookup and a rolling window sums the daily totals
+// inside the window ending on the expense's own date, so the ledger history is
+// never rescanned. Evaluating never changes the counters, and backdated or
+// future-dated expenses are counted on their own dates.
+enum class RuleKind {
+    CATEGORY_CAP,    // monthly spend cap for a category (or all expenses)
+    ROLLING_WINDOW,  // spend limit over the last N days
+    MIN_BALANCE      // balance must not drop below the limit
+};
+
+enum class RuleAction {
+    ALERT,  // warn, but record the transaction
+    BLOCK   // refuse the transaction
+};
+
+struct BudgetRule {
+    static const int ANY_CATEGORY = -1;
+
+    RuleKind kind;
+    RuleAction action;
+    int category;    // category index, or ANY_CATEGORY
+    double limit;    // cap, window limit or minimum balance
+    int windowDays;  // ROLLING_WINDOW only
+
+    BudgetRule(RuleKind k, RuleAction a, int cat, double lim, int window = 0)
+        : kind(k), action(a), category(cat), limit(lim), windowDays(window) {}
+};
+
+struct RuleViolation {
+    size_t ruleIndex;
+    double projected;  // counter value (or balance) the insert would produce
+};
+
+class BudgetRuleEngine {
+private:
+    std::vector<BudgetRule> rules;
+    std::vector<std::vector<size_t>> rulesByCategory;   // last slot = ANY_CATEGORY
+    std::vector<size_t> balanceRules;
+    std::unordered_map<long long, double> monthlySpend; // (month, category) -> total
+    std::vector<std::map<int, double>> dailySpend;      // [category] day number -> total
+    int categoryCount;
+
+    size_t bucketFor(int category) const {
+        return category == BudgetRule::ANY_CATEGORY ? static_cast<size_t>(categoryCount)
+                                                    : static_cast<size_t>(category);
+    }
+
+    long long spendKey(int monthIndex, int category) const {
+        return static_cast<long long>(monthIndex) * (categoryCount + 1) + static_cast<long long>(bucketFor(category));
+    }
+
+    void rebuildIndex() {
+        rulesByCategory.assign(categoryCount + 1, {});
+        balanceRules.clear();
+        for (size_t i = 0; i < rules.size(); i++) {
+            if (rules[i].kind == RuleKind::MIN_BALANCE) {
+                balanceRules.push_back(i);
+            } else {
+                rulesByCategory[bucketFor(rules[i].category)].push_back(i);
+            }
+        }
+    }
+
+    // Spending in a category over the days days ending on lastDay; O(log n + days)
+    double windowSpend(int category, int lastDay, int days) const {
+        const std::map<int, double>& spend = dailySpend[bucketFor(category)];
+        double sum = 0.0;
+        for (auto it = spend.lower_bound(lastDay - std::max(days, 1) + 1); it != spend.end() && it->first <= lastDay; ++it) {
+            sum += it->second;
+        }
+        return sum;
+    }
+
+    void checkSpendRules(const std::vector<size_t>& candidates, const Date& date, double amount,
+                         std::vector<RuleViolation>& out) const {
+        int day = date.toDayNumber();
+        for (size_t i : candidates) {
+            const BudgetRule& rule = rules[i];
+            double projected;
+            if (rule.kind == RuleKind::CATEGORY_CAP) {
+                auto it = monthlySpend.find(spendKey(date.monthIndex(), rule.category));
+                projected = (it != monthlySpend.end() ? it->second : 0.0) + amount;
+            } else {
+                projected = windowSpend(rule.category, day, rule.windowDays) + amount;
+            }
+            if (projected > rule.limit) {
+                out.push_back({i, projected});
+            }
+        }
+    }
+
+public:
+    explicit BudgetRuleEngine(int categories) : dailySpend(categories + 1), categoryCount(categories) {
+        rebuildIndex();
+    }
+
+    const std::vector<BudgetRule>& getRules() const {
+        return rules;
+    }
+
+    // Counters cover every category, so rules can be added at any time
+    void addRule(const BudgetRule& rule) {
+        rules.push_back(rule);
+        rebuildIndex();
+    }
+
+    bool removeRule(size_t index) {
+        if (index >= rules.size()) return false;
+        rules.erase(rules.begin() + index);
+        rebuildIndex();
+        return true;
+    }
+
+    void clearRules() {
+        rules.clear();
+        rebuildIndex();
+    }
+
+    // Resets every counter; rules are kept
+    void clearCounters() {
+        monthlySpend.clear();
+        for (auto& spend : dailySpend) spend.clear();
+    }
+
+    // Spend rules an expense would break; balance rules are checked
+    // separately with evaluateBalance
+    std::vector<RuleViolation> evaluateExpense(int category, const Date& date, double amount) const {
+        std::vector<RuleViolation> violations;
+        checkSpendRules(rulesByCategory[bucketFor(category)], date, amount, violations);
+        checkSpendRules(rulesByCategory[bucketFor(BudgetRule::ANY_CATEGORY)], date, amount, violations);
+        return violations;
+    }
+
+    void evaluateBalance(double balanceAfter, std::vector<RuleViolation>& out) const {
+        for (size_t i : balanceRules) {
+            if (balanceAfter < rules[i].limit) {
+                out.push_back({i, balanceAfter});
+            }
+        }
+    }
+
+    static bool blocks(const std::vector<BudgetRule>& rules, const std::vector<RuleViolation>& violations) {
+        for (const auto& v : violations) {
+            if (rules[v.ruleIndex].action == RuleAction::BLOCK) return true;
+        }
+        return false;
+    }
+
+    // Adds a recorded expense to the counters (a negative amount takes it back out)
+    void recordExpense(int category, const Date& date, double amount) {
+        monthlySpend[spendKey(date.monthIndex(), category)] += amount;
+        monthlySpend[spendKey(date.monthIndex(), BudgetRule::ANY_CATEGORY)] += amount;
+        int day = date.toDayNumber();
+        for (size_t b : {bucketFor(category), bucketFor(BudgetRule::ANY_CATEGORY)}) {
+            auto it = dailySpend[b].emplace(day, 0.0).first;
+            it->second += amount;
+            if (it->second == 0.0) dailySpend[b].erase(it);
+        }
+    }
+
+    // Current counter value for a spend rule (this month / window ending today)
+    double usage(size_t index, const Date& today) const {
+        const BudgetRule& rule = rules[index];
+        if (rule.kind == RuleKind::CATEGORY_CAP) {
+            auto it = monthlySpend.find(spendKey(today.monthIndex(), rule.category));
+            return it != monthlySpend.end() ? it->second : 0.0;
+        }
+        if (rule.kind == RuleKind::ROLLING_WINDOW) {
+            return windowSpend(rule.category, today.toDayNumber(), rule.windowDays);
+        }
+        return 0.0;
+    }
+};
@@ -0,0 +1,439 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <istream>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bank_import.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define PFMS_HAVE_IO_URING 1
+#endif
+#endif
+
+// Read-only istream over bytes already in memory, so text parsers written
+// against streams can run on a buffer without copying it
+class MemoryStream : public std::istream {
+private:
+    struct Buffer : std::streambuf {
+        Buffer(const char* data, size_t size) {
+            char* p = const_cast<char*>(data);
+            setg(p, p, p + size);
+        }
+    } buffer;
+
+public:
+    MemoryStream(const char* data, size_t size) : std::istream(nullptr), buffer(data, size) {
+        rdbuf(&buffer);
+    }
+};
+
+// Bounded multi-producer/multi-consumer queue; pop returns false once the
+// queue is closed and drained
+template <typename T>
+class WorkQueue {
+private:
+    std::deque<T> items;
+    std::mutex lock;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    size_t capacity;
+    bool closed;
+
+public:
+    explicit WorkQueue(size_t cap) : capacity(cap), closed(false) {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> guard(lock);
+        notFull.wait(guard, [&] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> guard(lock);
+        notEmpty.wait(guard, [&] { return !items.empty() || closed; });
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> guard(lock);
+        closed = true;
+        notEmpty.notify_all();
+    }
+};
+
+#ifdef PFMS_HAVE_IO_URING
+// Minimal io_uring ring for whole-file reads, set up with raw system calls
+// (no liburing). ok() is false if the kernel refuses the ring.
+class UringReader {
+private:
+    int ringFd;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned sqEntries;
+    io_uring_sqe* sqes;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    io_uring_cqe* cqes;
+    void* sqRing;
+    size_t sqRingSize;
+    void* cqRing;
+    size_t cqRingSize;
+    size_t sqesSize;
+    unsigned queued;
+
+public:
+    explicit UringReader(unsigned depth)
+        : ringFd(-1), sqes(nullptr), sqRing(MAP_FAILED), cqRing(MAP_FAILED), queued(0) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        int fd = static_cast<int>(::syscall(__NR_io_uring_setup, depth, &params));
+        if (fd < 0) return;
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        sqRing = ::mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        cqRing = single ? sqRing
+                        : ::mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* entries = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || entries == MAP_FAILED) {
+            if (entries != MAP_FAILED) ::munmap(entries, sqesSize);
+            ringFd = fd;
+            return;
+        }
+
+        char* sq = static_cast<char*>(sqRing);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sqEntries = params.sq_entries;
+        sqes = static_cast<io_uring_sqe*>(entries);
+        char* cq = static_cast<char*>(cqRing);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        ringFd = fd;
+    }
+
+    ~UringReader() {
+        if (sqes) ::munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED && cqRing != sqRing) ::munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED) ::munmap(sqRing, sqRingSize);
+        if (ringFd >= 0) ::close(ringFd);
+    }
+
+    UringReader(const UringReader&) = delete;
+    UringReader& operator=(const UringReader&) = delete;
+
+    bool ok() const {
+        return sqes != nullptr;
+    }
+
+    // Queues a read; false if the submission ring is full
+    bool queueRead(int fd, char* buffer, unsigned length, uint64_t offset, uint64_t tag) {
+        unsigned tail = *sqTail;
+        if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) return false;
+        unsigned index = tail & *sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(buffer);
+        sqe->len = length;
+        sqe->off = offset;
+        sqe->user_data = tag;
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        queued++;
+        return true;
+    }
+
+    // Submits the queued reads and waits for at least minComplete completions
+    bool submit(unsigned minComplete) {
+        int submitted;
+        do {
+            submitted = static_cast<int>(::syscall(__NR_io_uring_enter, ringFd, queued, minComplete,
+                                                   minComplete > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+        } while (submitted < 0 && errno == EINTR);
+        if (submitted < 0) return false;
+        queued -= std::min(queued, static_cast<unsigned>(submitted));
+        return true;
+    }
+
+    // Waits for at least minComplete completions without submitting anything
+    bool wait(unsigned minComplete) {
+        int result;
+        do {
+            result = static_cast<int>(::syscall(__NR_io_uring_enter, ringFd, 0, minComplete, IORING_ENTER_GETEVENTS,
+                                                nullptr, 0));
+        } while (result < 0 && errno == EINTR);
+        return result >= 0;
+    }
+
+    // Takes back the reads queued but not yet submitted, which the kernel has
+    // not seen, and returns their tags. The kernel only reads the submission
+    // ring inside submit, so moving the tail back is safe.
+    std::vector<uint64_t> withdraw() {
+        std::vector<uint64_t> tags;
+        unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        unsigned tail = *sqTail;
+        for (unsigned i = head; i != tail; i++) {
+            tags.push_back(sqes[sqArray[i & *sqMask]].user_data);
+        }
+        __atomic_store_n(sqTail, head, __ATOMIC_RELEASE);
+        queued = 0;
+        return tags;
+    }
+
+    // Takes one completion if there is one; result is bytes read or -errno
+    bool reap(uint64_t& tag, int& result) {
+        unsigned head = *cqHead;
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) return false;
+        const io_uring_cqe& cqe = cqes[head & *cqMask];
+        tag = cqe.user_data;
+        result = cqe.res;
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+};
+#endif
+
+// Drops a file's pages from the OS page cache so the next read goes to disk;
+// used to measure cold starts. False where this is not supported.
+inline bool evictFromPageCache(const std::string& path) {
+#if defined(POSIX_FADV_DONTNEED) && !defined(_WIN32)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    ::fdatasync(fd);  // dirty pages would stay cached
+    bool ok = ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    ::close(fd);
+    return ok;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+struct BulkReadStats {
+    size_t files = 0;
+    size_t failed = 0;
+    size_t bytes = 0;
+    bool usedIoUring = false;
+};
+
+namespace bulk_detail {
+
+struct LoadedFile {
+    size_t index;
+    std::vector<char> bytes;
+    bool ok;
+};
+
+#ifdef PFMS_HAVE_IO_URING
+// Keeps up to `depth` whole-file reads in flight and queues each file for
+// parsing as soon as its last byte arrives. Files the ring cannot read are
+// read with pread instead. A buffer the ring is reading into is never handed
+// on or freed until its completion has been reaped.
+inline void uringProduce(UringReader& ring, const std::vector<std::string>& paths, unsigned depth,
+                         WorkQueue<LoadedFile>& ready, BulkReadStats& stats) {
+    struct InFlight {
+        int fd;
+        size_t done;
+        std::vector<char> bytes;
+        bool reading;  // a read into bytes is queued or in the kernel
+    };
+    std::vector<InFlight> slots(paths.size());
+    size_t next = 0;
+    unsigned active = 0;
+    bool useRing = true;
+
+    auto finish = [&](size_t index, bool ok) {
+        InFlight& f = slots[index];
+        if (f.fd >= 0) ::close(f.fd);
+        f.fd = -1;
+        if (!ok) stats.failed++;
+        stats.bytes += f.bytes.size();
+        ready.push(LoadedFile{index, std::move(f.bytes), ok});
+    };
+
+    // Blocking read of whatever is still missing; false if the file came up short
+    auto readRest = [&](size_t index) {
+        InFlight& f = slots[index];
+        while (f.done < f.bytes.size()) {
+            ssize_t n = ::pread(f.fd, f.bytes.data() + f.done, f.bytes.size() - f.done, static_cast<off_t>(f.done));
+            if (n <= 0) break;
+            f.done += static_cast<size_t>(n);
+        }
+        bool complete = f.done == f.bytes.size();
+        f.bytes.resize(f.done);
+        return complete;
+    };
+
+    while (next < paths.size() || active > 0) {
+        while (next < paths.size() && active < depth) {
+            size_t index = next++;
+            InFlight& f = slots[index];
+            f.done = 0;
+            f.reading = false;
+            f.fd = ::open(paths[index].c_str(), O_RDONLY);
+            struct stat st;
+            if (f.fd < 0 || ::fstat(f.fd, &st) != 0) {
+                finish(index, false);
+                continue;
+            }
+            f.bytes.resize(static_cast<size_t>(st.st_size));
+            if (f.bytes.empty()) {
+                finish(index, true);
+                continue;
+            }
+            if (!useRing || !ring.queueRead(f.fd, f.bytes.data(), static_cast<unsigned>(f.bytes.size()), 0, index)) {
+                finish(index, readRest(index));
+                continue;
+            }
+            f.reading = true;
+            active++;
+        }
+        if (active == 0) continue;
+        uint64_t tag;
+        int result;
+        if (!ring.submit(1)) {
+            // The ring stopped working. Reads it never took are withdrawn and
+            // the ones already submitted are waited for, since the kernel may
+            // still be writing into their buffers; then the rest is read by hand.
+            useRing = false;
+            for (uint64_t withdrawn : ring.withdraw()) {
+                slots[static_cast<size_t>(withdrawn)].reading = false;
+                active--;
+            }
+            while (active > 0 && ring.wait(1)) {
+                while (ring.reap(tag, result)) {
+                    InFlight& f = slots[static_cast<size_t>(tag)];
+                    f.reading = false;
+                    active--;
+                    if (result > 0) f.done += static_cast<size_t>(result);
+                }
+            }
+            for (size_t i = 0; i < next; i++) {
+                InFlight& f = slots[i];
+                if (f.fd < 0) continue;
+                if (f.reading) {
+                    // Not even waiting works: leave the buffer to the kernel
+                    // for good and read the file again into a new one
+                    size_t size = f.bytes.size();
+                    (void)new std::vector<char>(std::move(f.bytes));
+                    f.bytes.assign(size, 0);
+                    f.done = 0;
+                    f.reading = false;
+                }
+                finish(i, readRest(i));
+            }
+            active = 0;
+            continue;
+        }
+        while (ring.reap(tag, result)) {
+            size_t index = static_cast<size_t>(tag);
+            InFlight& f = slots[index];
+            f.reading = false;
+            active--;
+            if (result > 0) f.done += static_cast<size_t>(result);
+            if (result > 0 && f.done < f.bytes.size() &&
+                    ring.queueRead(f.fd, f.bytes.data() + f.done, static_cast<unsigned>(f.bytes.size() - f.done), f.done, index)) {
+                f.reading = true;
+                active++;  // short read: ask for the rest
+                continue;
+            }
+            // Done, failed (e.g. an older kernel without IORING_OP_READ) or
+            // the ring is full: read what is left directly
+            finish(index, readRest(index));
+        }
+    }
+}
+#endif
+
+}  // namespace bulk_detail
+
+// Reads every file and calls onFile(index, data, size, ok) for each one on a
+// pool of worker threads, so parsing overlaps with the reads still pending.
+// With io_uring one thread keeps many reads in flight and the workers only
+// parse; otherwise each worker reads (memory-maps) a file and parses it, with
+// twice as many workers as cores so blocking reads overlap with parsing.
+// onFile runs concurrently for different files.
+template <typename F>
+BulkReadStats readFiles(const std::vector<std::string>& paths, F onFile, unsigned threads = 0, bool allowIoUring = true) {
+    BulkReadStats stats;
+    stats.files = paths.size();
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+#ifdef PFMS_HAVE_IO_URING
+    if (allowIoUring) {
+        const unsigned depth = 64;
+        UringReader ring(depth);
+        if (ring.ok()) {
+            stats.usedIoUring = true;
+            WorkQueue<bulk_detail::LoadedFile> ready(depth * 2);
+            std::vector<std::thread> workers;
+            for (unsigned i = 0; i < threads; i++) {
+                workers.emplace_back([&] {
+                    bulk_detail::LoadedFile file;
+                    while (ready.pop(file)) {
+                        onFile(file.index, file.bytes.data(), file.bytes.size(), file.ok);
+                        std::vector<char>().swap(file.bytes);
+                    }
+                });
+            }
+            bulk_detail::uringProduce(ring, paths, depth, ready, stats);
+            ready.close();
+            for (auto& worker : workers) worker.join();
+            return stats;
+        }
+    }
+#else
+    (void)allowIoUring;
+#endif
+
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> failed(0);
+    std::atomic<size_t> bytes(0);
+    std::vector<std::thread> workers;
+    unsigned count = static_cast<unsigned>(std::min<size_t>(threads * 2, std::max<size_t>(1, paths.size())));
+    for (unsigned i = 0; i < count; i++) {
+        workers.emplace_back([&] {
+            for (size_t index = next++; index < paths.size(); index = next++) {
+                MappedFile file(paths[index]);
+                if (!file.isOpen()) failed++;
+                bytes += file.size();
+                onFile(index, file.data(), file.size(), file.isOpen());
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    stats.failed = failed;
+    stats.bytes = bytes;
+    return stats;
+}
@@ -0,0 +1,280 @@
+#pragma once
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "date.h"
+#include "ledger_renderer.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#error "columnar exports are written little-endian"
+#endif
+
+// Streaming exports for analytics tools. Rows are handed to a writer one
+// value at a time in schema order; the writer keeps only the current batch,
+// so memory use depends on the batch size and not on the number of rows.
+// Both writers take the same calls, so one export routine serves both.
+
+enum class ColumnType : uint8_t {
+    INT32 = 1,
+    INT64 = 2,
+    FLOAT64 = 3,
+    DATE32 = 4,  // days since 1/1/1970
+    STRING = 5   // UTF-8
+};
+
+struct ColumnSpec {
+    const char* name;
+    ColumnType type;
+};
+
+enum class ExportFormat {
+    COLUMNAR,
+    NDJSON
+};
+
+// .ndjson and .jsonl files get NDJSON, anything else the columnar format
+inline ExportFormat exportFormatFor(const std::string& filename) {
+    size_t dot = filename.rfind('.');
+    std::string ext = dot == std::string::npos ? "" : filename.substr(dot);
+    return ext == ".ndjson" || ext == ".jsonl" || ext == ".json" ? ExportFormat::NDJSON : ExportFormat::COLUMNAR;
+}
+
+// Columnar file layout (all integers little-endian):
+//   "PFMSCOL1"
+//   uint32 column count, then per column: uint8 type, uint16 name length, name
+//   batches: uint32 row count (> 0), then every column in schema order:
+//     fixed-width types: row count values (4 or 8 bytes each)
+//     STRING: row count + 1 uint32 offsets into the bytes that follow
+//   uint32 0 ends the file
+// A reader can map each column of a batch straight into an array.
+class ColumnarWriter {
+public:
+    static constexpr size_t DEFAULT_BATCH_ROWS = 4096;
+
+private:
+    struct Column {
+        ColumnType type;
+        std::vector<char> values;      // fixed-width values, or string bytes
+        std::vector<uint32_t> offsets;  // STRING only
+    };
+
+    std::ostream& out;
+    std::vector<Column> columns;
+    size_t batchRows;
+    size_t rows;   // in the current batch
+    size_t total;
+    size_t cursor;  // next column of the current row
+
+    void writeRaw(const void* data, size_t size) {
+        out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    }
+
+    void writeU32(uint32_t value) {
+        writeRaw(&value, sizeof(value));
+    }
+
+    template <typename T>
+    void put(T value) {
+        std::vector<char>& values = columns[cursor++].values;
+        size_t at = values.size();
+        values.resize(at + sizeof(T));
+        std::memcpy(values.data() + at, &value, sizeof(T));
+    }
+
+    void flushBatch() {
+        if (rows == 0) return;
+        writeU32(static_cast<uint32_t>(rows));
+        for (auto& column : columns) {
+            if (column.type == ColumnType::STRING) {
+                writeRaw(column.offsets.data(), column.offsets.size() * sizeof(uint32_t));
+                column.offsets.resize(1);
+            }
+            writeRaw(column.values.data(), column.values.size());
+            column.values.clear();  // keeps the capacity for the next batch
+        }
+        rows = 0;
+    }
+
+public:
+    ColumnarWriter(std::ostream& os, const std::vector<ColumnSpec>& schema, size_t batch = DEFAULT_BATCH_ROWS)
+        : out(os), batchRows(batch > 0 ? batch : DEFAULT_BATCH_ROWS), rows(0), total(0), cursor(0) {
+        writeRaw("PFMSCOL1", 8);
+        writeU32(static_cast<uint32_t>(schema.size()));
+        for (const auto& spec : schema) {
+            uint8_t type = static_cast<uint8_t>(spec.type);
+            uint16_t length = static_cast<uint16_t>(std::strlen(spec.name));
+            writeRaw(&type, 1);
+            writeRaw(&length, 2);
+            writeRaw(spec.name, length);
+            Column column{spec.type, {}, {}};
+            if (spec.type == ColumnType::STRING) {
+                column.offsets.reserve(batchRows + 1);
+                column.offsets.push_back(0);
+            } else {
+                column.values.reserve(batchRows * (spec.type == ColumnType::INT32 || spec.type == ColumnType::DATE32 ? 4 : 8));
+            }
+            columns.push_back(std::move(column));
+        }
+    }
+
+    void int32(int32_t value) { put(value); }
+    void int64(int64_t value) { put(value); }
+    void float64(double value) { put(value); }
+    void date(int dayNumber) { put(static_cast<int32_t>(dayNumber)); }
+
+    void string(const char* data, size_t size) {
+        Column& column = columns[cursor++];
+        column.values.insert(column.values.end(), data, data + size);
+        column.offsets.push_back(static_cast<uint32_t>(column.values.size()));
+    }
+
+    void string(const std::string& s) {
+        string(s.data(), s.size());
+    }
+
+    void string(const char* s) {
+        string(s, std::strlen(s));
+    }
+
+    void endRow() {
+        cursor = 0;
+        total++;
+        if (++rows == batchRows) flushBatch();
+    }
+
+    // Writes the last batch and the end marker
+    bool finish() {
+        flushBatch();
+        writeU32(0);
+        out.flush();
+        return static_cast<bool>(out);
+    }
+
+    size_t rowCount() const { return total; }
+};
+
+// Newline-delimited JSON, one object per row, formatted straight into an
+// OutputBuffer that is written out every batch
+class NdjsonWriter {
+private:
+    std::ostream& out;
+    OutputBuffer buffer;
+    std::vector<std::string> names;  // "\"name\":" prefixes
+    size_t batchRows;
+    size_t rows;
+    size_t total;
+    size_t cursor;
+
+    void key() {
+        buffer.append(cursor == 0 ? '{' : ',');
+        buffer.append(names[cursor++]);
+    }
+
+    void number(const char* data, size_t size) {
+        key();
+        buffer.append(data, size);
+    }
+
+    void quoted(const char* data, size_t size) {
+        static const char hex[] = "0123456789abcdef";
+        buffer.append('"');
+        size_t start = 0;
+        for (size_t i = 0; i < size; i++) {
+            unsigned char c = static_cast<unsigned char>(data[i]);
+            if (c >= 0x20 && c != '"' && c != '\\') continue;
+            buffer.append(data + start, i - start);
+            start = i + 1;
+            if (c == '"' || c == '\\') {
+                char escaped[2] = {'\\', static_cast<char>(c)};
+                buffer.append(escaped, 2);
+            } else if (c == '\n') {
+                buffer.append("\\n", 2);
+            } else if (c == '\t') {
+                buffer.append("\\t", 2);
+            } else {
+                char escaped[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+                buffer.append(escaped, 6);
+            }
+        }
+        buffer.append(data + start, size - start);
+        buffer.append('"');
+    }
+
+public:
+    NdjsonWriter(std::ostream& os, const std::vector<ColumnSpec>& schema,
+                 size_t batch = ColumnarWriter::DEFAULT_BATCH_ROWS)
+        : out(os), buffer(os), batchRows(batch > 0 ? batch : ColumnarWriter::DEFAULT_BATCH_ROWS),
+          rows(0), total(0), cursor(0) {
+        for (const auto& spec : schema) {
+            names.push_back("\"" + std::string(spec.name) + "\":");
+        }
+    }
+
+    void int32(int32_t value) { int64(value); }
+
+    void int64(int64_t value) {
+        char tmp[24];
+        auto res = std::to_chars(tmp, tmp + sizeof(tmp), value);
+        number(tmp, static_cast<size_t>(res.ptr - tmp));
+    }
+
+    // Shortest form that reads back to the same double; JSON has no NaN or infinity
+    void float64(double value) {
+        if (!std::isfinite(value)) {
+            number("null", 4);
+            return;
+        }
+        char tmp[32];
+        auto res = std::to_chars(tmp, tmp + sizeof(tmp), value);
+        number(tmp, static_cast<size_t>(res.ptr - tmp));
+    }
+
+    // ISO 8601, e.g. "2025-01-31"
+    void date(int dayNumber) {
+        Date d = Date::fromDayNumber(dayNumber);
+        char tmp[24];
+        char* p = std::to_chars(tmp, tmp + 12, d.year).ptr;
+        *p++ = '-';
+        *p++ = static_cast<char>('0' + d.month / 10);
+        *p++ = static_cast<char>('0' + d.month % 10);
+        *p++ = '-';
+        *p++ = static_cast<char>('0' + d.day / 10);
+        *p++ = static_cast<char>('0' + d.day % 10);
+        key();
+        quoted(tmp, static_cast<size_t>(p - tmp));
+    }
+
+    void string(const char* data, size_t size) {
+        key();
+        quoted(data, size);
+    }
+
+    void string(const std::string& s) {
+        string(s.data(), s.size());
+    }
+
+    void string(const char* s) {
+        string(s, std::strlen(s));
+    }
+
+    void endRow() {
+        buffer.append("}\n", 2);
+        cursor = 0;
+        total++;
+        if (++rows == batchRows) {
+            buffer.flush();
+            rows = 0;
+        }
+    }
+
+    bool finish() {
+        buffer.flush();
+        return static_cast<bool>(out);
+    }
+
+    size_t rowCount() const { return total; }
+};
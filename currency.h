@@ -0,0 +1,282 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "date.h"
+#include "ledger_renderer.h"
+
+// ISO 4217 code packed into 15 bits, five per letter. The zero code stands
+// for the ledger's base currency, so records that never had a currency (and
+// every record in older data files) need no conversion.
+class CurrencyCode {
+private:
+    uint16_t packed;
+
+    explicit CurrencyCode(uint16_t value) : packed(value) {}
+
+public:
+    CurrencyCode() : packed(0) {}
+
+    static CurrencyCode fromValue(uint16_t value) {
+        return CurrencyCode(value);
+    }
+
+    // Three letters in any case, e.g. "usd"
+    static bool parse(const std::string& text, CurrencyCode& code) {
+        if (text.size() != 3) return false;
+        uint16_t value = 0;
+        for (char c : text) {
+            if (!std::isalpha(static_cast<unsigned char>(c))) return false;
+            value = static_cast<uint16_t>(value << 5 | (std::toupper(static_cast<unsigned char>(c)) - 'A' + 1));
+        }
+        code = CurrencyCode(value);
+        return true;
+    }
+
+    bool isBase() const { return packed == 0; }
+    uint16_t value() const { return packed; }
+
+    // Three letters into out; nothing for the base code
+    size_t write(char* out) const {
+        if (packed == 0) return 0;
+        out[0] = static_cast<char>('A' - 1 + (packed >> 10 & 31));
+        out[1] = static_cast<char>('A' - 1 + (packed >> 5 & 31));
+        out[2] = static_cast<char>('A' - 1 + (packed & 31));
+        return 3;
+    }
+
+    std::string toString() const {
+        char tmp[3];
+        return std::string(tmp, write(tmp));
+    }
+
+    bool operator==(const CurrencyCode& other) const { return packed == other.packed; }
+    bool operator!=(const CurrencyCode& other) const { return packed != other.packed; }
+};
+
+// Amount followed by its currency, right-aligned like OutputBuffer::field;
+// base amounts are written as before
+inline void renderAmount(OutputBuffer& out, double amount, CurrencyCode code, int width) {
+    if (code.isBase()) {
+        out.field(amount, width, 2);
+        return;
+    }
+    char tmp[72];
+    auto res = std::to_chars(tmp, tmp + 64, amount, std::chars_format::fixed, 2);
+    if (res.ec != std::errc()) {
+        out.field("?", width);
+        return;
+    }
+    char* p = res.ptr;
+    *p++ = ' ';
+    p += code.write(p);
+    out.field(tmp, static_cast<size_t>(p - tmp), width);
+}
+
+// Daily exchange rates into the base currency, read from a file with lines
+// "<code> <day> <month> <year> <rate>" (one unit of the currency is worth
+// <rate> in the base currency from that day until the next entry) and an
+// optional "BASE <code>" line naming the base. Lines starting with '#' are
+// ignored. Each currency caches its rates as one array indexed by day, built
+// when its rates change, so a lookup is an array read and the table can be
+// read from several threads at once; days before the first or after the last
+// entry use the nearest rate. Copies share the arrays.
+class FxTable {
+private:
+    struct Series {
+        std::map<int, double> steps;  // day number -> rate
+        std::shared_ptr<const std::vector<double>> daily;
+        int firstDay = 0;
+
+        void build() {
+            firstDay = steps.begin()->first;
+            int lastDay = steps.rbegin()->first;
+            auto table = std::make_shared<std::vector<double>>(static_cast<size_t>(lastDay - firstDay + 1), 0.0);
+            auto step = steps.begin();
+            double rate = step->second;
+            for (int day = firstDay; day <= lastDay; day++) {
+                if (step != steps.end() && step->first == day) {
+                    rate = step->second;
+                    ++step;
+                }
+                (*table)[day - firstDay] = rate;
+            }
+            daily = std::move(table);
+        }
+
+        double rateOn(int day) const {
+            const std::vector<double>& table = *daily;
+            int index = std::min(std::max(day - firstDay, 0), static_cast<int>(table.size()) - 1);
+            return table[index];
+        }
+    };
+
+    CurrencyCode base;  // its real code, for display; stored as the zero code
+    std::map<uint16_t, Series> series;
+
+    const Series* find(CurrencyCode code) const {
+        auto it = series.find(code.value());
+        return it != series.end() ? &it->second : nullptr;
+    }
+
+    // Adds one step without rebuilding; the caller builds the series
+    Series* addStep(CurrencyCode code, const Date& from, double rate) {
+        code = normalize(code);
+        if (code.isBase() || rate <= 0) return nullptr;
+        Series& s = series[code.value()];
+        s.steps[from.toDayNumber()] = rate;
+        return &s;
+    }
+
+public:
+    static constexpr const char* DEFAULT_BASE = "INR";
+
+    FxTable() {
+        CurrencyCode::parse(DEFAULT_BASE, base);
+    }
+
+    CurrencyCode getBase() const { return base; }
+
+    void setBase(CurrencyCode code) {
+        if (!code.isBase()) base = code;
+    }
+
+    // The base currency's own code becomes the zero code
+    CurrencyCode normalize(CurrencyCode code) const {
+        return code == base ? CurrencyCode() : code;
+    }
+
+    // Display code, with the base currency under its real code
+    std::string codeOf(CurrencyCode code) const {
+        return (code.isBase() ? base : code).toString();
+    }
+
+    bool has(CurrencyCode code) const {
+        return code.isBase() || find(code) != nullptr;
+    }
+
+    size_t currencyCount() const { return series.size(); }
+
+    // Identifies the base and every rate, so amounts converted earlier (the
+    // archive summaries) can tell whether they were converted at these rates
+    uint64_t stamp() const {
+        auto mix = [](uint64_t x) {
+            x += 0x9e3779b97f4a7c15ULL;
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            return x ^ (x >> 31);
+        };
+        uint64_t h = mix(base.value());
+        for (const auto& entry : series) {
+            h = mix(h ^ entry.first);
+            for (const auto& step : entry.second.steps) {
+                uint64_t bits;
+                std::memcpy(&bits, &step.second, sizeof bits);
+                h = mix(mix(h ^ static_cast<uint32_t>(step.first)) ^ bits);
+            }
+        }
+        return h;
+    }
+
+    std::vector<CurrencyCode> getCurrencies() const {
+        std::vector<CurrencyCode> codes;
+        for (const auto& entry : series) codes.push_back(CurrencyCode::fromValue(entry.first));
+        return codes;
+    }
+
+    void setRate(CurrencyCode code, const Date& from, double rate) {
+        Series* s = addStep(code, from, rate);
+        if (s) s->build();
+    }
+
+    // 1 for the base currency and for currencies without rates; check has()
+    // before relying on a conversion
+    double rateOn(CurrencyCode code, int day) const {
+        if (code.isBase()) return 1.0;
+        const Series* s = find(code);
+        return s ? s->rateOn(day) : 1.0;
+    }
+
+    double toBase(CurrencyCode code, int day, double amount) const {
+        return code.isBase() ? amount : amount * rateOn(code, day);
+    }
+
+    // Converts amounts[i] from codes[i] on days[i] to the base currency in
+    // place. Base rows are skipped. Each currency remembers its last day and
+    // rate, so rows grouped by currency and date (e.g. read in date order)
+    // look a rate up once per group. Returns the number of lookups.
+    size_t convert(const uint16_t* codes, const int32_t* days, double* amounts, size_t n) const {
+        struct Recent {
+            uint16_t code;
+            int32_t day;
+            double rate;
+        };
+        static constexpr size_t RECENT = 8;
+        Recent recent[RECENT];
+        size_t used = 0;
+        size_t lookups = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint16_t code = codes[i];
+            if (code == 0) continue;
+            size_t slot = 0;
+            while (slot < used && recent[slot].code != code) slot++;
+            if (slot == used) {
+                if (used < RECENT) used++;
+                else slot = i % RECENT;  // more currencies than slots: reuse one
+                recent[slot].code = code;
+                recent[slot].day = days[i] - 1;
+            }
+            Recent& r = recent[slot];
+            if (r.day != days[i]) {
+                r.day = days[i];
+                r.rate = rateOn(CurrencyCode::fromValue(code), days[i]);
+                lookups++;
+            }
+            amounts[i] *= r.rate;
+        }
+        return lookups;
+    }
+
+    void clear() {
+        series.clear();
+    }
+
+    // Returns the number of rates read, or -1 if the file could not be opened
+    int loadFromFile(const std::string& filename) {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            return -1;
+        }
+        int loaded = 0;
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            std::istringstream fields(line);
+            std::string name;
+            fields >> name;
+            CurrencyCode code;
+            if (name == "BASE") {
+                std::string baseName;
+                if (fields >> baseName && CurrencyCode::parse(baseName, code)) setBase(code);
+                continue;
+            }
+            int day, month, year;
+            double rate;
+            if (CurrencyCode::parse(name, code) && fields >> day >> month >> year >> rate &&
+                    Date(day, month, year).isValid()) {
+                addStep(code, Date(day, month, year), rate);
+                loaded++;
+            }
+        }
+        for (auto& entry : series) entry.second.build();
+        return loaded;
+    }
+};
@@ -112,4 +112,18 @@ public:
         auto it = transactionMap.find(id);
         return it != transactionMap.end() ? it->second : nullptr;
     }
+    
+    // Points an existing id at another record; nullptr removes it
+    void setTransaction(const std::string& id, Transaction* transaction) {
+        if (transaction) {
+            transactionMap[id] = transaction;
+        } else {
+            transactionMap.erase(id);
+        }
+    }
+    
+    void clear() {
+        transactionMap.clear();
+        nextId = 0;
+    }
 }; 
\ No newline at end of file
@@ -12,15 +12,73 @@ public:
     Date() {
         auto now = std::chrono::system_clock::now();
         time_t now_time = std::chrono::system_clock::to_time_t(now);
-        tm* now_tm = localtime(&now_time);
+        // localtime shares one buffer between threads
+        tm now_tm;
+#ifdef _WIN32
+        localtime_s(&now_tm, &now_time);
+#else
+        localtime_r(&now_time, &now_tm);
+#endif
         
-        day = now_tm->tm_mday;
-        month = now_tm->tm_mon + 1;
-        year = now_tm->tm_year + 1900;
+        day = now_tm.tm_mday;
+        month = now_tm.tm_mon + 1;
+        year = now_tm.tm_year + 1900;
     }
     
     Date(int d, int m, int y) : day(d), month(m), year(y) {}
     
+    // Days since 1/1/1970 (proleptic Gregorian), used as a dense date key
+    int toDayNumber() const {
+        int y = year - (month <= 2 ? 1 : 0);
+        int era = (y >= 0 ? y : y - 399) / 400;
+        int yoe = y - era * 400;
+        int mp = (month + 9) % 12;
+        int doy = (153 * mp + 2) / 5 + day - 1;
+        int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + doe - 719468;
+    }
+    
+    static Date fromDayNumber(int days) {
+        days += 719468;
+        int era = (days >= 0 ? days : days - 146096) / 146097;
+        int doe = days - era * 146097;
+        int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        int mp = (5 * doy + 2) / 153;
+        int d = doy - (153 * mp + 2) / 5 + 1;
+        int m = mp < 10 ? mp + 3 : mp - 9;
+        int y = yoe + era * 400 + (m <= 2 ? 1 : 0);
+        return Date(d, m, y);
+    }
+    
+    // Months since January of year 0, used to key monthly counters
+    int monthIndex() const {
+        return year * 12 + (month - 1);
+    }
+    
+    static bool isLeapYear(int y) {
+        return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+    }
+    
+    static int daysInMonth(int m, int y) {
+        static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        return (m == 2 && isLeapYear(y)) ? 29 : days[m - 1];
+    }
+    
+    bool isValid() const {
+        return month >= 1 && month <= 12 && day >= 1 && day <= daysInMonth(month, year);
+    }
+    
+    bool operator<(const Date& other) const {
+        if (year != other.year) return year < other.year;
+        if (month != other.month) return month < other.month;
+        return day < other.day;
+    }
+    
+    bool operator==(const Date& other) const {
+        return day == other.day && month == other.month && year == other.year;
+    }
+    
     std::string toString() const {
         return std::to_string(day) + "/" + std::to_string(month) + "/" + std::to_string(year);
     }
@@ -35,8 +93,8 @@ public:
         return ofs;
     }
     
-    friend std::ifstream& operator>>(std::ifstream& ifs, Date& date) {
-        ifs >> date.day >> date.month >> date.year;
-        return ifs;
+    friend std::istream& operator>>(std::istream& is, Date& date) {
+        is >> date.day >> date.month >> date.year;
+        return is;
     }
 }; 
\ No newline at end of file
@@ -0,0 +1,121 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Records kept in date order in fixed-size leaf chunks, each with the first
+// and last day it holds: the leaf level of a B+tree under a single sorted
+// directory. An insert binary-searches the directory and then its chunk,
+// and splits the chunk in half when it is full, so backdated entries cost
+// the same as new ones. A range scan seeks to the first chunk that can hold
+// the start day and stops at the first chunk that begins after the end day.
+template <typename T>
+class DateChunkStore {
+public:
+    static constexpr size_t CHUNK_SIZE = 64;
+
+private:
+    struct Entry {
+        int day;
+        T value;
+    };
+
+    struct Chunk {
+        int minDay;
+        int maxDay;
+        std::vector<Entry> entries;
+    };
+
+    std::vector<Chunk> chunks;
+    size_t count;
+
+    static bool entryBefore(int day, const Entry& e) {
+        return day < e.day;
+    }
+
+    static void refreshBounds(Chunk& chunk) {
+        chunk.minDay = chunk.entries.front().day;
+        chunk.maxDay = chunk.entries.back().day;
+    }
+
+    // First chunk whose last day is not before the day
+    size_t firstChunkFor(int day) const {
+        auto it = std::lower_bound(chunks.begin(), chunks.end(), day,
+                                   [](const Chunk& c, int d) { return c.maxDay < d; });
+        return static_cast<size_t>(it - chunks.begin());
+    }
+
+public:
+    DateChunkStore() : count(0) {}
+
+    size_t size() const { return count; }
+    size_t chunkCount() const { return chunks.size(); }
+
+    // Records with equal days keep their insertion order
+    void insert(int day, const T& value) {
+        if (chunks.empty()) {
+            chunks.push_back(Chunk{day, day, {}});
+            chunks.back().entries.reserve(CHUNK_SIZE);
+        }
+        // The chunk after the last one holding this day, or the last chunk
+        auto it = std::upper_bound(chunks.begin(), chunks.end(), day,
+                                   [](int d, const Chunk& c) { return d < c.maxDay; });
+        size_t index = it == chunks.end() ? chunks.size() - 1 : static_cast<size_t>(it - chunks.begin());
+        Chunk* chunk = &chunks[index];
+        if (chunk->entries.size() == CHUNK_SIZE) {
+            Chunk upper;
+            upper.entries.reserve(CHUNK_SIZE);
+            upper.entries.assign(chunk->entries.begin() + CHUNK_SIZE / 2, chunk->entries.end());
+            chunk->entries.resize(CHUNK_SIZE / 2);
+            refreshBounds(*chunk);
+            refreshBounds(upper);
+            chunks.insert(chunks.begin() + index + 1, std::move(upper));
+            if (day >= chunks[index + 1].minDay) index++;
+            chunk = &chunks[index];
+        }
+        auto pos = std::upper_bound(chunk->entries.begin(), chunk->entries.end(), day, entryBefore);
+        chunk->entries.insert(pos, Entry{day, value});
+        refreshBounds(*chunk);
+        count++;
+    }
+
+    // Removes one record with this day and value
+    bool erase(int day, const T& value) {
+        for (size_t c = firstChunkFor(day); c < chunks.size() && chunks[c].minDay <= day; c++) {
+            auto& entries = chunks[c].entries;
+            auto pos = std::lower_bound(entries.begin(), entries.end(), day,
+                                        [](const Entry& e, int d) { return e.day < d; });
+            for (; pos != entries.end() && pos->day == day; ++pos) {
+                if (pos->value == value) {
+                    entries.erase(pos);
+                    if (entries.empty()) chunks.erase(chunks.begin() + c);
+                    else refreshBounds(chunks[c]);
+                    count--;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void clear() {
+        chunks.clear();
+        count = 0;
+    }
+
+    // fn(day, value) for every record from `from` to `to` (inclusive), in date order
+    template <typename F>
+    void forEachInRange(int from, int to, F fn) const {
+        for (size_t c = firstChunkFor(from); c < chunks.size() && chunks[c].minDay <= to; c++) {
+            const auto& entries = chunks[c].entries;
+            auto pos = entries.begin();
+            if (chunks[c].minDay < from) {
+                pos = std::lower_bound(entries.begin(), entries.end(), from,
+                                       [](const Entry& e, int d) { return e.day < d; });
+            }
+            for (; pos != entries.end() && pos->day <= to; ++pos) {
+                fn(pos->day, pos->value);
+            }
+        }
+    }
+};
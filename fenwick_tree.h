@@ -0,0 +1,180 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "date.h"
+
+// Binary indexed (Fenwick) tree: point updates and prefix sums in O(log n)
+template <typename T>
+class FenwickTree {
+private:
+    std::vector<T> tree;  // 1-based
+
+public:
+    explicit FenwickTree(size_t n = 0) : tree(n + 1, T()) {}
+
+    // Built from point values in O(n)
+    explicit FenwickTree(const std::vector<T>& values) : tree(values.size() + 1, T()) {
+        for (size_t i = 1; i < tree.size(); i++) {
+            tree[i] += values[i - 1];
+            size_t parent = i + (i & (~i + 1));
+            if (parent < tree.size()) tree[parent] += tree[i];
+        }
+    }
+
+    size_t size() const {
+        return tree.size() - 1;
+    }
+
+    void add(size_t index, T delta) {
+        for (size_t i = index + 1; i < tree.size(); i += i & (~i + 1)) {
+            tree[i] += delta;
+        }
+    }
+
+    // Point values back out of the tree in O(n), undoing the construction above
+    std::vector<T> points() const {
+        std::vector<T> sums(tree);
+        for (size_t i = sums.size() - 1; i > 0; i--) {
+            size_t parent = i + (i & (~i + 1));
+            if (parent < sums.size()) sums[parent] -= sums[i];
+        }
+        return std::vector<T>(sums.begin() + 1, sums.end());
+    }
+
+    // Sum of [0, index]
+    T prefix(size_t index) const {
+        T sum = T();
+        for (size_t i = std::min(index + 1, tree.size() - 1); i > 0; i -= i & (~i + 1)) {
+            sum += tree[i];
+        }
+        return sum;
+    }
+
+    // Sum of [from, to]
+    T range(size_t from, size_t to) const {
+        if (from > to) return T();
+        return from == 0 ? prefix(to) : prefix(to) - prefix(from - 1);
+    }
+};
+
+// Signed amounts keyed by date, overall and per category, for point-in-time
+// balances and date-range sums in O(log n). The trees cover a window of days
+// that starts around the first date seen and doubles when a date falls
+// outside it, so a ledger spanning a few years costs a few tens of KB per
+// tree. Dates before 1/1/1970 or after 31/12/2100 are clamped. Amounts are
+// kept in cents so updates and removals cancel exactly. Category trees are
+// allocated on first use.
+class DateSumIndex {
+private:
+    static constexpr int FIRST_DAY = 0;       // 1/1/1970
+    static constexpr int LAST_DAY = 47845;    // 31/12/2100
+    static constexpr int INITIAL_SPAN = 2048;
+
+    FenwickTree<int64_t> overall;
+    std::vector<FenwickTree<int64_t>> byCategory;
+    int64_t total;
+    int base;  // day of slot 0
+    int span;  // days covered; 0 until the first add
+
+    static int clampDay(int day) {
+        return std::min(std::max(day, FIRST_DAY), LAST_DAY);
+    }
+
+    static int64_t toCents(double amount) {
+        return static_cast<int64_t>(std::llround(amount * 100.0));
+    }
+
+    FenwickTree<int64_t> rebased(const FenwickTree<int64_t>& tree, int newBase, int newSpan) const {
+        std::vector<int64_t> points(newSpan, 0);
+        std::vector<int64_t> old = tree.points();
+        std::copy(old.begin(), old.end(), points.begin() + (base - newBase));
+        return FenwickTree<int64_t>(points);
+    }
+
+    // Widens the window to hold the day, at least doubling it
+    void cover(int day) {
+        if (span == 0) {
+            base = std::max(FIRST_DAY, std::min(day - INITIAL_SPAN / 2, LAST_DAY + 1 - INITIAL_SPAN));
+            span = INITIAL_SPAN;
+            overall = FenwickTree<int64_t>(span);
+            return;
+        }
+        if (day >= base && day < base + span) return;
+        int newSpan = span;
+        int newBase = base;
+        while (day < newBase || day >= newBase + newSpan) {
+            newSpan = std::min(newSpan * 2, LAST_DAY - FIRST_DAY + 1);
+            newBase = day < base ? base + span - newSpan : base;
+            newBase = std::max(FIRST_DAY, std::min(newBase, LAST_DAY + 1 - newSpan));
+        }
+        overall = rebased(overall, newBase, newSpan);
+        for (auto& tree : byCategory) {
+            if (tree.size() > 0) tree = rebased(tree, newBase, newSpan);
+        }
+        base = newBase;
+        span = newSpan;
+    }
+
+    // Sum of a tree over [from, to], with the days outside the window empty
+    int64_t rangeOf(const FenwickTree<int64_t>& tree, int from, int to) const {
+        from = std::max(clampDay(from), base);
+        to = std::min(clampDay(to), base + span - 1);
+        if (span == 0 || tree.size() == 0 || from > to) return 0;
+        return tree.range(from - base, to - base);
+    }
+
+public:
+    explicit DateSumIndex(int categories)
+        : byCategory(categories), total(0), base(FIRST_DAY), span(0) {}
+
+    // A negative category only updates the overall tree (e.g. investments)
+    void add(const Date& date, int category, double amount) {
+        int64_t cents = toCents(amount);
+        int day = clampDay(date.toDayNumber());
+        cover(day);
+        overall.add(day - base, cents);
+        total += cents;
+        if (category >= 0 && static_cast<size_t>(category) < byCategory.size()) {
+            FenwickTree<int64_t>& tree = byCategory[category];
+            if (tree.size() == 0) {
+                tree = FenwickTree<int64_t>(span);
+            }
+            tree.add(day - base, cents);
+        }
+    }
+
+    void clear() {
+        overall = FenwickTree<int64_t>();
+        for (auto& tree : byCategory) {
+            tree = FenwickTree<int64_t>();
+        }
+        total = 0;
+        base = FIRST_DAY;
+        span = 0;
+    }
+
+    double totalAmount() const {
+        return total / 100.0;
+    }
+
+    // Net of everything dated on or before the day
+    double upTo(const Date& date) const {
+        int day = clampDay(date.toDayNumber());
+        if (span == 0 || day < base) return 0.0;
+        if (day >= base + span) return total / 100.0;
+        return overall.prefix(day - base) / 100.0;
+    }
+
+    double between(const Date& from, const Date& to) const {
+        return rangeOf(overall, from.toDayNumber(), to.toDayNumber()) / 100.0;
+    }
+
+    double categoryBetween(int category, const Date& from, const Date& to) const {
+        if (category < 0 || static_cast<size_t>(category) >= byCategory.size()) {
+            return 0.0;
+        }
+        return rangeOf(byCategory[category], from.toDayNumber(), to.toDayNumber()) / 100.0;
+    }
+};
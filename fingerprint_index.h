@@ -0,0 +1,214 @@
+#pragma once
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Duplicate detection: a compact open-addressing set of 64-bit fingerprints of
+// (day, amount, normalized description, category). Each record costs one
+// 8-byte slot (about 11 bytes at the maximum load), and a lookup probes the
+// exact day plus every day of the fuzzy window, so checks are O(window) and
+// independent of the ledger size. The table is saved next to the ledger so it
+// does not have to be rebuilt at startup; it is only reused for the exact
+// data file it was saved with.
+class FingerprintIndex {
+private:
+    static constexpr uint64_t EMPTY = 0;
+    static constexpr uint32_t FILE_MAGIC = 0x50465032;  // "PFP2"
+    static constexpr uint64_t MAX_SLOTS = uint64_t(1) << 30;  // 8 GB, far beyond any ledger
+
+    std::vector<uint64_t> slots;
+    size_t count;
+    int windowDays;
+
+    static uint64_t mix(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    size_t mask() const {
+        return slots.size() - 1;
+    }
+
+    void grow() {
+        std::vector<uint64_t> old;
+        old.swap(slots);
+        slots.assign(old.empty() ? 1024 : old.size() * 2, EMPTY);
+        count = 0;
+        for (uint64_t fp : old) {
+            if (fp != EMPTY) insertFingerprint(fp);
+        }
+    }
+
+    void insertFingerprint(uint64_t fp) {
+        if ((count + 1) * 4 > slots.size() * 3) {
+            grow();
+        }
+        size_t i = fp & mask();
+        while (slots[i] != EMPTY) {
+            i = (i + 1) & mask();
+        }
+        slots[i] = fp;
+        count++;
+    }
+
+    bool containsFingerprint(uint64_t fp) const {
+        if (slots.empty()) return false;
+        for (size_t i = fp & mask(); slots[i] != EMPTY; i = (i + 1) & mask()) {
+            if (slots[i] == fp) return true;
+        }
+        return false;
+    }
+
+public:
+    explicit FingerprintIndex(int window = 3) : count(0), windowDays(window) {}
+
+    int getWindowDays() const { return windowDays; }
+    void setWindowDays(int days) { windowDays = days < 0 ? 0 : days; }
+    size_t size() const { return count; }
+
+    // Hash of everything but the date: amount in cents, category, and the
+    // description lower-cased with runs of whitespace collapsed
+    static uint64_t contentHash(double amount, int category, const std::string& description) {
+        uint64_t h = 1469598103934665603ULL;  // FNV-1a
+        bool started = false;
+        bool pendingSpace = false;
+        for (unsigned char c : description) {
+            if (std::isspace(c)) {
+                pendingSpace = started;
+                continue;
+            }
+            if (pendingSpace) {
+                h = (h ^ ' ') * 1099511628211ULL;
+            }
+            started = true;
+            pendingSpace = false;
+            h = (h ^ static_cast<unsigned char>(std::tolower(c))) * 1099511628211ULL;
+        }
+        int64_t cents = static_cast<int64_t>(std::llround(amount * 100.0));
+        return mix(h ^ mix(static_cast<uint64_t>(cents)) ^ (static_cast<uint64_t>(category) << 56));
+    }
+
+    static uint64_t fingerprint(uint64_t content, int day) {
+        uint64_t fp = mix(content ^ static_cast<uint64_t>(static_cast<uint32_t>(day)));
+        return fp == EMPTY ? 1 : fp;
+    }
+
+    // True if the same record exists within windowDays of the given day
+    bool contains(uint64_t content, int day) const {
+        if (count == 0) return false;
+        for (int d = day - windowDays; d <= day + windowDays; d++) {
+            if (containsFingerprint(fingerprint(content, d))) return true;
+        }
+        return false;
+    }
+
+    // Identical records may be inserted more than once
+    void insert(uint64_t content, int day) {
+        insertFingerprint(fingerprint(content, day));
+    }
+
+    // Removes one occurrence; linear probing with backward-shift deletion
+    bool erase(uint64_t content, int day) {
+        if (slots.empty()) return false;
+        uint64_t fp = fingerprint(content, day);
+        size_t i = fp & mask();
+        while (slots[i] != fp) {
+            if (slots[i] == EMPTY) return false;
+            i = (i + 1) & mask();
+        }
+        size_t hole = i;
+        for (size_t j = (hole + 1) & mask(); slots[j] != EMPTY; j = (j + 1) & mask()) {
+            size_t home = slots[j] & mask();
+            // Move j back if its home slot is not in (hole, j]
+            bool between = hole <= j ? (home > hole && home <= j) : (home > hole || home <= j);
+            if (!between) {
+                slots[hole] = slots[j];
+                hole = j;
+            }
+        }
+        slots[hole] = EMPTY;
+        count--;
+        return true;
+    }
+
+    void clear() {
+        slots.clear();
+        count = 0;
+    }
+
+    // FNV-1a over a data file's bytes; continue a hash by passing it back in
+    static uint64_t hashBytes(const char* data, size_t size, uint64_t h = 1469598103934665603ULL) {
+        for (size_t i = 0; i < size; i++) {
+            h = (h ^ static_cast<unsigned char>(data[i])) * 1099511628211ULL;
+        }
+        return h;
+    }
+
+    static uint64_t hashFile(const std::string& filename) {
+        std::ifstream file(filename, std::ios::binary);
+        char block[1 << 16];
+        uint64_t h = hashBytes(nullptr, 0);
+        while (file.read(block, sizeof(block)) || file.gcount() > 0) {
+            h = hashBytes(block, static_cast<size_t>(file.gcount()), h);
+        }
+        return h;
+    }
+
+    // The ledger record count and the hash of the data file are stored with
+    // the table; a mismatch on load means the ledger changed without the
+    // index (e.g. it was edited by hand) and it has to be rebuilt
+    bool saveToFile(const std::string& filename, uint64_t ledgerCount, uint64_t dataHash) const {
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open()) return false;
+        uint64_t header[5] = {FILE_MAGIC, ledgerCount, dataHash, count, slots.size()};
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(slots.data()), static_cast<std::streamsize>(slots.size() * sizeof(uint64_t)));
+        return static_cast<bool>(file);
+    }
+
+    // A table that does not hold together (size, load, slot count) is
+    // rejected like a stale one, so a damaged file is rebuilt rather than
+    // probed forever
+    bool loadFromFile(const std::string& filename, uint64_t ledgerCount, uint64_t dataHash) {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) return false;
+        uint64_t header[5];
+        if (!file.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+            header[0] != FILE_MAGIC || header[1] != ledgerCount || header[2] != dataHash) {
+            return false;
+        }
+        uint64_t stored = header[3];
+        uint64_t capacity = header[4];
+        if (capacity == 0) {
+            if (stored != 0) return false;
+            clear();
+            return true;
+        }
+        if (capacity > MAX_SLOTS || (capacity & (capacity - 1)) != 0 ||
+            stored > ledgerCount || stored * 4 > capacity * 3) {
+            return false;
+        }
+        // The slots must be exactly the rest of the file
+        std::streampos start = file.tellg();
+        file.seekg(0, std::ios::end);
+        if (file.tellg() - start != static_cast<std::streamoff>(capacity * sizeof(uint64_t))) return false;
+        file.seekg(start);
+        std::vector<uint64_t> loaded(capacity);
+        if (!file.read(reinterpret_cast<char*>(loaded.data()), static_cast<std::streamsize>(capacity * sizeof(uint64_t)))) {
+            return false;
+        }
+        uint64_t used = 0;
+        for (uint64_t fp : loaded) {
+            if (fp != EMPTY) used++;
+        }
+        if (used != stored) return false;
+        slots.swap(loaded);
+        count = stored;
+        return true;
+    }
+};
@@ -0,0 +1,138 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "date.h"
+
+// Dense day-indexed cash-flow timeline. Events are accumulated into a net
+// flow per day and the running balance is their prefix sum. Amounts are kept
+// in integer cents, so sums are exact and the kernels below are plain
+// branch-free loops over contiguous arrays that the compiler can vectorize.
+// Per-block minima let breach searches skip whole blocks, and what-if deltas
+// are applied as a suffix add instead of rebuilding the timeline.
+class ForecastTimeline {
+public:
+    static const int NO_BREACH = -1;
+
+private:
+    static const int BLOCK = 64;
+
+    int startDay;
+    std::vector<int64_t> flows;     // net flow per day
+    std::vector<int64_t> balances;  // running balance per day
+    std::vector<int64_t> blockMin;  // minimum balance of each BLOCK-day block
+    int64_t opening;
+    bool built;
+
+    static int64_t toCents(double amount) {
+        return static_cast<int64_t>(std::llround(amount * 100.0));
+    }
+
+    void recomputeBlock(size_t block) {
+        size_t begin = block * BLOCK;
+        size_t end = std::min(begin + BLOCK, balances.size());
+        int64_t m = std::numeric_limits<int64_t>::max();
+        for (size_t i = begin; i < end; i++) {
+            m = std::min(m, balances[i]);
+        }
+        blockMin[block] = m;
+    }
+
+public:
+    ForecastTimeline(int firstDay, int days, double openingBalance)
+        : startDay(firstDay), flows(days > 0 ? days : 1, 0), opening(toCents(openingBalance)), built(false) {}
+
+    int getStartDay() const { return startDay; }
+    int getEndDay() const { return startDay + static_cast<int>(flows.size()) - 1; }
+    size_t size() const { return flows.size(); }
+
+    bool contains(int day) const {
+        return day >= startDay && day <= getEndDay();
+    }
+
+    // Events before the start land on the first day; events past the end are dropped
+    void addEvent(int day, double amount) {
+        if (day > getEndDay()) return;
+        flows[day < startDay ? 0 : day - startDay] += toCents(amount);
+        built = false;
+    }
+
+    // Prefix-sum kernel: balances[i] = opening + flows[0] + ... + flows[i]
+    void build() {
+        size_t n = flows.size();
+        balances.resize(n);
+        int64_t running = opening;
+        for (size_t i = 0; i < n; i++) {
+            running += flows[i];
+            balances[i] = running;
+        }
+        blockMin.resize((n + BLOCK - 1) / BLOCK);
+        for (size_t b = 0; b < blockMin.size(); b++) {
+            recomputeBlock(b);
+        }
+        built = true;
+    }
+
+    bool isBuilt() const { return built; }
+
+    double balanceOn(int day) const {
+        if (day < startDay) return opening / 100.0;
+        size_t i = std::min(static_cast<size_t>(day - startDay), balances.size() - 1);
+        return balances[i] / 100.0;
+    }
+
+    // First day the balance drops below the minimum, or NO_BREACH
+    int firstBreach(double minimum) const {
+        int64_t limit = toCents(minimum);
+        for (size_t b = 0; b < blockMin.size(); b++) {
+            if (blockMin[b] >= limit) continue;
+            size_t begin = b * BLOCK;
+            size_t end = std::min(begin + BLOCK, balances.size());
+            for (size_t i = begin; i < end; i++) {
+                if (balances[i] < limit) return startDay + static_cast<int>(i);
+            }
+        }
+        return NO_BREACH;
+    }
+
+    // Lowest balance over the horizon and the first day it is reached
+    double lowestBalance(int& day) const {
+        size_t best = 0;
+        for (size_t b = 1; b < blockMin.size(); b++) {
+            if (blockMin[b] < blockMin[best]) best = b;
+        }
+        size_t begin = best * BLOCK;
+        size_t end = std::min(begin + BLOCK, balances.size());
+        size_t at = begin;
+        for (size_t i = begin; i < end; i++) {
+            if (balances[i] < balances[at]) at = i;
+        }
+        day = startDay + static_cast<int>(at);
+        return balances[at] / 100.0;
+    }
+
+    // What-if: one extra flow on a day. Only the suffix after it changes, so
+    // the balances are shifted in place and untouched blocks just move their
+    // minimum by the same amount.
+    void applyDelta(int day, double amount) {
+        if (!built) {
+            addEvent(day, amount);
+            build();
+            return;
+        }
+        if (day > getEndDay()) return;
+        size_t from = day < startDay ? 0 : static_cast<size_t>(day - startDay);
+        int64_t delta = toCents(amount);
+        flows[from] += delta;
+        for (size_t i = from; i < balances.size(); i++) {
+            balances[i] += delta;
+        }
+        size_t firstBlock = from / BLOCK;
+        recomputeBlock(firstBlock);
+        for (size_t b = firstBlock + 1; b < blockMin.size(); b++) {
+            blockMin[b] += delta;
+        }
+    }
+};
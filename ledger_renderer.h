@@ -0,0 +1,191 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "date.h"
+
+// Reusable output buffer for listings. Fields are formatted with to_chars
+// straight into one large buffer which is written out in big chunks, instead
+// of going through setw/cout (and endl flushes) for every field.
+class OutputBuffer {
+private:
+    std::vector<char> buffer;
+    size_t used;
+    std::ostream& out;
+
+    void reserve(size_t n) {
+        if (used + n > buffer.size()) {
+            flush();
+            if (n > buffer.size()) {
+                buffer.resize(n);
+            }
+        }
+    }
+
+    void padLeft(size_t len, int width) {
+        if (width > 0 && len < static_cast<size_t>(width)) {
+            spaces(static_cast<size_t>(width) - len);
+        }
+    }
+
+public:
+    explicit OutputBuffer(std::ostream& os, size_t capacity = 64 * 1024)
+        : buffer(capacity), used(0), out(os) {}
+
+    ~OutputBuffer() {
+        flush();
+    }
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    void append(const char* data, size_t len) {
+        reserve(len);
+        std::memcpy(buffer.data() + used, data, len);
+        used += len;
+    }
+
+    void append(const std::string& s) {
+        append(s.data(), s.size());
+    }
+
+    void append(const char* s) {
+        append(s, std::strlen(s));
+    }
+
+    void append(char c) {
+        reserve(1);
+        buffer[used++] = c;
+    }
+
+    void spaces(size_t n) {
+        reserve(n);
+        std::memset(buffer.data() + used, ' ', n);
+        used += n;
+    }
+
+    void repeat(char c, size_t n) {
+        reserve(n);
+        std::memset(buffer.data() + used, c, n);
+        used += n;
+    }
+
+    void newline() {
+        append('\n');
+    }
+
+    // Right-aligned fields, same layout as setw
+    void field(const char* s, size_t len, int width) {
+        padLeft(len, width);
+        append(s, len);
+    }
+
+    void field(const std::string& s, int width) {
+        field(s.data(), s.size(), width);
+    }
+
+    void field(const char* s, int width) {
+        field(s, std::strlen(s), width);
+    }
+
+    void field(long long value, int width) {
+        char tmp[24];
+        auto res = std::to_chars(tmp, tmp + sizeof(tmp), value);
+        field(tmp, static_cast<size_t>(res.ptr - tmp), width);
+    }
+
+    void field(double value, int width, int precision) {
+        char tmp[64];
+        auto res = std::to_chars(tmp, tmp + sizeof(tmp), value, std::chars_format::fixed, precision);
+        if (res.ec != std::errc()) {
+            field("?", width);
+            return;
+        }
+        field(tmp, static_cast<size_t>(res.ptr - tmp), width);
+    }
+
+    // Dates are written as d/m/y, matching Date::toString()
+    void field(const Date& date, int width) {
+        char tmp[40];
+        char* p = std::to_chars(tmp, tmp + 12, date.day).ptr;
+        *p++ = '/';
+        p = std::to_chars(p, p + 12, date.month).ptr;
+        *p++ = '/';
+        p = std::to_chars(p, p + 12, date.year).ptr;
+        field(tmp, static_cast<size_t>(p - tmp), width);
+    }
+
+    void flush() {
+        if (used > 0) {
+            out.write(buffer.data(), static_cast<std::streamsize>(used));
+            used = 0;
+        }
+        out.flush();
+    }
+};
+
+// Sorting, paging and --limit/--offset options for ledger listings
+enum class SortKey {
+    NONE,
+    DATE,
+    AMOUNT,
+    CATEGORY,
+    DESCRIPTION
+};
+
+struct ListingOptions {
+    SortKey sortKey = SortKey::NONE;
+    bool descending = false;
+    size_t offset = 0;
+    size_t limit = 0;     // 0 = no limit
+    size_t pageSize = 0;  // 0 = no paging
+    int fromDay = INT_MIN;  // --from/--to as day numbers
+    int toDay = INT_MAX;
+
+    bool hasDateRange() const {
+        return fromDay != INT_MIN || toDay != INT_MAX;
+    }
+
+    // Index one past the last row that will be shown
+    size_t windowEnd(size_t rowCount) const {
+        if (offset >= rowCount) return offset;
+        if (limit == 0 || limit > rowCount - offset) return rowCount;
+        return offset + limit;
+    }
+};
+
+inline bool parseSortKey(const std::string& name, SortKey& key) {
+    if (name == "none") key = SortKey::NONE;
+    else if (name == "date") key = SortKey::DATE;
+    else if (name == "amount") key = SortKey::AMOUNT;
+    else if (name == "category") key = SortKey::CATEGORY;
+    else if (name == "description") key = SortKey::DESCRIPTION;
+    else return false;
+    return true;
+}
+
+// Returns the rows of the [offset, offset + limit) window in display order.
+// Only the rows up to the end of the window are ordered (partial_sort), the
+// rest are never sorted or formatted.
+template <typename T, typename Less>
+std::vector<T> selectWindow(std::vector<T> rows, const ListingOptions& opts, Less less) {
+    size_t end = opts.windowEnd(rows.size());
+    if (opts.offset >= rows.size()) {
+        return {};
+    }
+
+    if (opts.sortKey != SortKey::NONE) {
+        if (opts.descending) {
+            auto greater = [&less](const T& a, const T& b) { return less(b, a); };
+            std::partial_sort(rows.begin(), rows.begin() + end, rows.end(), greater);
+        } else {
+            std::partial_sort(rows.begin(), rows.begin() + end, rows.end(), less);
+        }
+    }
+
+    return std::vector<T>(rows.begin() + opts.offset, rows.begin() + end);
+}
@@ -11,8 +11,30 @@
 #include <queue>
 #include <unordered_map>
 #include <memory>
+#include <functional>
+#include <cstdlib>
+#include <cerrno>
+#include <cctype>
+#include <sstream>
+#include <cstdio>
+#include <filesystem>
 #include "date.h"
 #include "data_structures.h"
+#include "ledger_renderer.h"
+#include "budget_rules.h"
+#include "recurrence.h"
+#include "forecast.h"
+#include "rate_table.h"
+#include "bank_import.h"
+#include "fingerprint_index.h"
+#include "fenwick_tree.h"
+#include "persistent_vector.h"
+#include "date_store.h"
+#include "segment_store.h"
+#include "bulk_reader.h"
+#include "columnar_export.h"
+#include "query.h"
+#include "currency.h"
 using namespace std;
 
 // Add category enum for expense categorization
@@ -44,6 +66,8 @@ string categoryToString(Category cat) {
     }
 }
 
+const int CATEGORY_COUNT = static_cast<int>(Category::OTHER) + 1;
+
 // Function to convert string to Category
 Category stringToCategory(const string& str) {
     if (str == "Income") return Category::INCOME;
@@ -57,12 +81,52 @@ Category stringToCategory(const string& str) {
     return Category::OTHER;
 }
 
+// Descriptions are stored as one whitespace-free token in the data file
+string encodeField(const string& str) {
+    string out;
+    out.reserve(str.size());
+    for (char c : str) {
+        if (c == '%') out += "%25";
+        else if (c == ' ') out += "%20";
+        else if (c == '\t') out += "%09";
+        else if (c == '\n') out += "%0A";
+        else if (c == '\r') out += "%0D";
+        else out += c;
+    }
+    return out;
+}
+
+string decodeField(const string& str) {
+    string out;
+    out.reserve(str.size());
+    for (size_t i = 0; i < str.size(); i++) {
+        if (str[i] == '%' && i + 2 < str.size() && isxdigit(static_cast<unsigned char>(str[i + 1]))
+                && isxdigit(static_cast<unsigned char>(str[i + 2]))) {
+            out += static_cast<char>(stoi(str.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            out += str[i];
+        }
+    }
+    return out;
+}
+
 class Transaction {
 protected:
-    double amount;
+    double amount;  // in the transaction's own currency
     string description;
     Date date;
     Category category;
+    CurrencyCode currency;
+
+    // Record layout: <tag> amount description day month year category [currency]
+    void saveFields(ofstream& file, const char* tag) const {
+        file << tag << " " << amount << " " << encodeField(description) << " ";
+        file << date;
+        file << " " << categoryToString(category);
+        if (!currency.isBase()) file << " " << currency.toString();
+        file << endl;
+    }
 
 public:
     Transaction(double amt, const string &des, Category cat = Category::OTHER) {
@@ -72,15 +136,22 @@ public:
         category = cat;
     }
     
-    Transaction(double amt, const string &des, const Date& dt, Category cat = Category::OTHER) {
-        amount = amt;
-        description = des;
-        date = dt;
-        category = cat;
-    }
+    // Initializer list: a default-constructed Date would query the clock
+    Transaction(double amt, const string &des, const Date& dt, Category cat = Category::OTHER)
+        : amount(amt), description(des), date(dt), category(cat) {}
 
-    virtual void display() {
-        cout << setw(12) << date << setw(15) << amount << setw(15) << categoryToString(category) << setw(20) << description;
+    virtual ~Transaction() = default;
+
+    void display() {
+        OutputBuffer out(cout);
+        render(out);
+    }
+    
+    virtual void render(OutputBuffer& out) const {
+        out.field(date, 12);
+        renderAmount(out, amount, currency, 15);
+        out.field(categoryToString(category), 15);
+        out.field(description, 20);
     }
     
     virtual double getAmount() const {
@@ -95,13 +166,26 @@ public:
         return date;
     }
     
-    string getDescription() const {
+    const string& getDescription() const {
         return description;
     }
     
+    CurrencyCode getCurrency() const {
+        return currency;
+    }
+    
+    void setCurrency(CurrencyCode code) {
+        currency = code;
+    }
+    
+    // Positive for money coming in, negative for money going out
+    virtual double signedAmount() const {
+        return amount;
+    }
+    
     // For file I/O
     virtual void saveToFile(ofstream& file) const {
-        file << "T " << amount << " " << description << " " << date << " " << categoryToString(category) << endl;
+        saveFields(file, "T");
     }
     
     virtual string getType() const {
@@ -117,14 +201,14 @@ public:
     Income(double amt, const string& des, const Date& dt, Category cat = Category::INCOME) 
         : Transaction(amt, des, dt, cat) {}
 
-    void display() override {
-        cout << setw(15) << "Income";
-        Transaction::display();
-        cout << endl;
+    void render(OutputBuffer& out) const override {
+        out.field("Income", 15);
+        Transaction::render(out);
+        out.newline();
     }
     
     void saveToFile(ofstream& file) const override {
-        file << "I " << amount << " " << description << " " << date << " " << categoryToString(category) << endl;
+        saveFields(file, "I");
     }
     
     string getType() const override {
@@ -140,14 +224,18 @@ public:
     Expenditure(double amt, const string &des, const Date& dt, Category cat = Category::OTHER) 
         : Transaction(amt, des, dt, cat) {}
 
-    void display() override {
-        cout << setw(15) << "Expenditure";
-        Transaction::display();
-        cout << endl;
+    void render(OutputBuffer& out) const override {
+        out.field("Expenditure", 15);
+        Transaction::render(out);
+        out.newline();
     }
     
     void saveToFile(ofstream& file) const override {
-        file << "E " << amount << " " << description << " " << date << " " << categoryToString(category) << endl;
+        saveFields(file, "E");
+    }
+    
+    double signedAmount() const override {
+        return -amount;
     }
     
     string getType() const override {
@@ -160,28 +248,66 @@ protected:
     double amount;
     int duration;
     Date startDate;
+    const RateCurve* rates;
+    CurrencyCode currency;
+
+    // Ends a saved record
+    void saveCurrency(ofstream& file) const {
+        if (!currency.isBase()) file << " " << currency.toString();
+        file << endl;
+    }
+
+    // Rate curve for this product; the built-in rates until a table is attached
+    const RateCurve& curve() const {
+        return rates ? *rates : RateTable::builtin().curve(getType());
+    }
+
+    // Called when a rate table is attached, for products that keep a rate
+    virtual void ratesAttached() {}
+
+    // Whole months since the start, capped at maturity
+    int elapsedMonths(const Date& on) const {
+        return max(0, min(on.monthIndex() - startDate.monthIndex(), duration * 12));
+    }
 
 public:
     Investment(double amt, int dur) {
         amount = amt;
         duration = dur;
         startDate = Date(); // Current date
+        rates = nullptr;
     }
     
-    Investment(double amt, int dur, const Date& dt) {
-        amount = amt;
-        duration = dur;
-        startDate = dt;
+    Investment(double amt, int dur, const Date& dt)
+        : amount(amt), duration(dur), startDate(dt), rates(nullptr) {}
+    
+    virtual ~Investment() = default;
+    
+    void attachRates(const RateTable& table) {
+        rates = &table.curve(getType());
+        ratesAttached();
     }
 
-    virtual void display() {
-        cout << setw(15) << amount << setw(15) << duration << setw(15) << startDate;
+    void display() {
+        OutputBuffer out(cout);
+        render(out);
+    }
+    
+    virtual void render(OutputBuffer& out) const {
+        renderAmount(out, amount, currency, 15);
+        out.field(static_cast<long long>(duration), 15);
+        out.field(startDate, 15);
     }
 
     virtual double maturityAmount() {
         return amount;
     }
     
+    // Value on a given date (month granularity)
+    virtual double valueAt(const Date&) const {
+        return amount;
+    }
+    
     double getAmount() const {
         return amount;
     }
@@ -194,9 +320,24 @@ public:
         return startDate;
     }
     
+    CurrencyCode getCurrency() const {
+        return currency;
+    }
+    
+    void setCurrency(CurrencyCode code) {
+        currency = code;
+    }
+    
+    Date maturityDate() const {
+        int year = startDate.year + duration;
+        return Date(min(startDate.day, Date::daysInMonth(startDate.month, year)), startDate.month, year);
+    }
+    
     // For file I/O
     virtual void saveToFile(ofstream& file) const {
-        file << "INV " << amount << " " << duration << " " << startDate << endl;
+        file << "INV " << amount << " " << duration << " ";
+        file << startDate;
+        saveCurrency(file);
     }
     
     virtual string getType() const {
@@ -217,23 +358,34 @@ public:
         monthly = monAmt;
     }
 
-    void display() override {
-        cout << setw(15) << "SIP";
-        Investment::display();
-        cout << setw(20) << monthly << endl;
+    void render(OutputBuffer& out) const override {
+        out.field("SIP", 15);
+        Investment::render(out);
+        renderAmount(out, monthly, currency, 20);
+        out.newline();
     }
 
     double maturityAmount() override {
-        double final = amount * pow(1 + (0.096/12), duration*12);
+        int start = startDate.monthIndex();
+        double final = amount * curve().growth(start, start + duration * 12);
         return final + (monthly * 12 * duration);
     }
     
+    double valueAt(const Date& on) const override {
+        int start = startDate.monthIndex();
+        int months = elapsedMonths(on);
+        return amount * curve().growth(start, start + months) + monthly * months;
+    }
+    
     double getMonthly() const {
         return monthly;
     }
     
     void saveToFile(ofstream& file) const override {
-        file << "SIP " << amount << " " << duration << " " << startDate << " " << monthly << endl;
+        file << "SIP " << amount << " " << duration << " ";
+        file << startDate;
+        file << " " << monthly;
+        saveCurrency(file);
     }
     
     string getType() const override {
@@ -241,24 +393,42 @@ public:
     }
 };
 
+// A deposit keeps the rate in force in the month it opened
 class FD : public Investment {
+private:
+    double monthlyGrowth;  // at that rate
+
+    void ratesAttached() override {
+        monthlyGrowth = curve().monthlyGrowthAt(startDate.monthIndex());
+    }
+
 public:
-    FD(double amt, int dur) : Investment(amt, dur) {}
+    FD(double amt, int dur) : Investment(amt, dur) {
+        ratesAttached();
+    }
     
-    FD(double amt, int dur, const Date& dt) : Investment(amt, dur, dt) {}
+    FD(double amt, int dur, const Date& dt) : Investment(amt, dur, dt) {
+        ratesAttached();
+    }
 
-    void display() override {
-        cout << setw(15) << "FD";
-        Investment::display();
-        cout << endl;
+    void render(OutputBuffer& out) const override {
+        out.field("FD", 15);
+        Investment::render(out);
+        out.newline();
     }
 
     double maturityAmount() override {
-        return amount * pow((1 + 0.071), duration);
+        return amount * pow(monthlyGrowth, duration * 12);
+    }
+    
+    double valueAt(const Date& on) const override {
+        return amount * pow(monthlyGrowth, elapsedMonths(on));
     }
     
     void saveToFile(ofstream& file) const override {
-        file << "FD " << amount << " " << duration << " " << startDate << endl;
+        file << "FD " << amount << " " << duration << " ";
+        file << startDate;
+        saveCurrency(file);
     }
     
     string getType() const override {
@@ -266,251 +436,2011 @@ public:
     }
 };
 
+// One immutable version of the transaction list. Slots never move: deleting
+// a transaction leaves an empty slot, so a slot (and the id derived from it)
+// names the same entry in every version. Changing a slot is O(log n) and
+// shares the rest of the list with the previous version.
+class Ledger {
+private:
+    PersistentVector<Transaction*> slots;
+    size_t live;
+
+    Ledger(const PersistentVector<Transaction*>& s, size_t n) : slots(s), live(n) {}
+
+public:
+    Ledger() : live(0) {}
+
+    // Number of transactions, not counting empty slots
+    size_t size() const { return live; }
+    size_t slotCount() const { return slots.size(); }
+
+    bool sameAs(const Ledger& other) const {
+        return slots.sameAs(other.slots);
+    }
+
+    Transaction* at(size_t slot) const {
+        return slot < slots.size() ? slots[slot] : nullptr;
+    }
+
+    Ledger append(Transaction* t) const {
+        return Ledger(slots.pushBack(t), live + 1);
+    }
+
+    // nullptr empties the slot
+    Ledger replace(size_t slot, Transaction* t) const {
+        Transaction* old = at(slot);
+        return Ledger(slots.set(slot, t), live - (old ? 1 : 0) + (t ? 1 : 0));
+    }
+
+    template <typename F>
+    void forEach(F fn) const {
+        slots.forEach([&](size_t, Transaction* t) {
+            if (t) fn(t);
+        });
+    }
+
+    // fn(slot, t) for every transaction, in slot order
+    template <typename F>
+    void forEachSlot(F fn) const {
+        slots.forEach([&](size_t slot, Transaction* t) {
+            if (t) fn(slot, t);
+        });
+    }
+
+    vector<Transaction*> toVector() const {
+        vector<Transaction*> rows;
+        rows.reserve(live);
+        forEach([&](Transaction* t) { rows.push_back(t); });
+        return rows;
+    }
+
+    // fn(slot, before, after) for every slot that differs; either may be null
+    template <typename F>
+    void diff(const Ledger& other, F fn) const {
+        slots.diff(other.slots, [&](size_t slot, Transaction* const* before, Transaction* const* after) {
+            Transaction* a = before ? *before : nullptr;
+            Transaction* b = after ? *after : nullptr;
+            if (a != b) fn(slot, a, b);
+        });
+    }
+};
+
+// Tables that can be exported for analysis
+enum class ExportTable {
+    TRANSACTIONS,
+    INVESTMENTS,
+    AGGREGATES
+};
+
+bool parseExportTable(const string& name, ExportTable& table) {
+    if (name == "transactions") table = ExportTable::TRANSACTIONS;
+    else if (name == "investments") table = ExportTable::INVESTMENTS;
+    else if (name == "aggregates") table = ExportTable::AGGREGATES;
+    else return false;
+    return true;
+}
+
 class FinanceManager {
 private:
     // Add new member variables
     std::priority_queue<UpcomingPayment, std::vector<UpcomingPayment>, PaymentCompare> upcomingPayments;
     Trie descriptionTrie;
     TransactionIndex transactionIndex;
+    BudgetRuleEngine budgetRules;
+    vector<RecurrenceRule> recurring;
+    RateTable rateTable;
+    FingerprintIndex fingerprints;
+    DateSumIndex amounts;
 
-public:
-    vector<Transaction*> transactions;
-    vector<Investment*> investments;
+    // One undoable state: the ledger plus every recurring rule's posting
+    // watermark, so undoing a post makes those occurrences due again
+    struct LedgerVersion {
+        Ledger ledger;
+        vector<pair<int, int>> postedThrough;  // rule id -> watermark
+    };
+    VersionHistory<LedgerVersion> history;
+    int nextRecurringId;
+    DateChunkStore<Transaction*> byDate;  // current version in date order
 
-    FinanceManager() {}
+    // Cold storage: transactions of years before the hot window are moved out
+    // of the data file into one segment file per year at load time. Their
+    // summaries stay in memory; rows are read on demand through the cache.
+    typedef vector<unique_ptr<Transaction>> ColdSegment;
+    SummaryIndex coldSummaries;
+    SegmentCache<ColdSegment> coldCache;
+    string archiveBase;  // data file name without extension
+    int hotYears;
+    bool archiving;  // off for read-only loads
+    size_t unrated;      // rows read in currencies without exchange rates
+    size_t unratedCold;  // of those, rows found in segments
+    vector<Transaction*> records;  // every record any version refers to
     
-    ~FinanceManager() {
-        // Clean up memory
-        for (auto t : transactions) {
-            delete t;
-        }
-        for (auto i : investments) {
-            delete i;
-        }
+    // Exchange rates into the base currency. Balances, counters, range
+    // indexes and archive summaries hold base amounts at the rate on each
+    // record's date; reports convert the rows they read in batches.
+    FxTable fx;
+    CurrencyCode ledgerBase;  // base currency of the last data file read
+    
+    double baseAmount(const Transaction* t) const {
+        return fx.toBase(t->getCurrency(), t->getDate().toDayNumber(), t->getAmount());
+    }
+    
+    double baseSigned(const Transaction* t) const {
+        return fx.toBase(t->getCurrency(), t->getDate().toDayNumber(), t->signedAmount());
     }
 
-    void addTransaction(Transaction* t) {
-        transactions.push_back(t);
+    // Rows without a rate count at face value and are never archived, since
+    // the summaries would keep that value after the rate is added
+    bool rated(const Transaction* t) const {
+        return fx.has(t->getCurrency());
+    }
+
+    // Everything addTransaction does except the duplicate fingerprint
+    void indexTransaction(Transaction* t) {
+        records.push_back(t);
+        transactions = transactions.append(t);
         descriptionTrie.insert(t->getDescription());
-        std::string id = transactionIndex.addTransaction(t);
-        // You might want to store the ID somewhere in the Transaction class
+        // Ids are handed out in slot order, so this one is idForSlot(slot)
+        transactionIndex.addTransaction(t);
+        remember(t);
     }
 
-    void addInvestment(Investment* i) {
-        investments.push_back(i);
+    // Per-record counters; forget undoes remember exactly
+    void remember(Transaction* t) {
+        if (t->signedAmount() < 0) {
+            budgetRules.recordExpense(static_cast<int>(t->getCategory()), t->getDate(), baseAmount(t));
+        }
+        amounts.add(t->getDate(), static_cast<int>(t->getCategory()), baseSigned(t));
+        byDate.insert(t->getDate().toDayNumber(), t);
     }
 
-    void displayRecord(double balance) {
-        cout << "-----------------------------------\n";
-        cout << "|        Personal Finance        |\n";
-        cout << "-----------------------------------\n";
+    void forget(Transaction* t) {
+        if (t->signedAmount() < 0) {
+            budgetRules.recordExpense(static_cast<int>(t->getCategory()), t->getDate(), -baseAmount(t));
+        }
+        amounts.add(t->getDate(), static_cast<int>(t->getCategory()), -baseSigned(t));
+        byDate.erase(t->getDate().toDayNumber(), t);
+    }
 
-        cout << "\n||--BALANCE--: " << fixed << setprecision(2) << balance << "||" << endl;
+    void appendTransaction(Transaction* t) {
+        indexTransaction(t);
+        fingerprints.insert(fingerprintOf(t), t->getDate().toDayNumber());
+    }
 
-        cout << "\n--SAVINGS--: \n";
-        cout << setw(15) << "Type" << setw(12) << "Date" << setw(15) << "Amount" << setw(15) << "Category" << setw(20) << "Description" << endl;
-        cout << string(77, '-') << endl;
-        for (auto t : transactions) {
-            t->display();
+    LedgerVersion currentVersion() const {
+        LedgerVersion version{transactions, {}};
+        for (const auto& rule : recurring) {
+            version.postedThrough.emplace_back(rule.id, rule.postedThrough);
         }
-
-        cout << "\n--INVESTMENTS--\n";
-        cout << setw(15) << "Type" << setw(15) << "Amount" << setw(15) << "Duration" << setw(15) << "Start Date" << setw(20) << "Monthly amount" << endl;
-        cout << string(80, '-') << endl;
-        for (auto i : investments) {
-            i->display();
+        return version;
+    }
+    
+    // Rules added since the version keep their watermark
+    void switchTo(const LedgerVersion& target, double& balance) {
+        switchTo(target.ledger, balance);
+        for (auto& rule : recurring) {
+            for (const auto& entry : target.postedThrough) {
+                if (entry.first == rule.id) rule.postedThrough = entry.second;
+            }
         }
     }
     
-    // Generate monthly report
-    void generateMonthlyReport(int month, int year) {
-        cout << "\n----- Monthly Report for " << month << "/" << year << " -----\n";
+    // Makes target the current version, updating only the slots that differ
+    void switchTo(const Ledger& target, double& balance) {
+        transactions.diff(target, [&](size_t slot, Transaction* before, Transaction* after) {
+            if (before) {
+                forget(before);
+                fingerprints.erase(fingerprintOf(before), before->getDate().toDayNumber());
+                balance -= baseSigned(before);
+            }
+            if (after) {
+                remember(after);
+                fingerprints.insert(fingerprintOf(after), after->getDate().toDayNumber());
+                balance += baseSigned(after);
+            }
+            transactionIndex.setTransaction(idForSlot(slot), after);
+        });
+        transactions = target;
+    }
+
+    // The same amount in another currency is not a duplicate; base records
+    // keep the hash they always had
+    static uint64_t fingerprintOf(const Transaction* t) {
+        return FingerprintIndex::contentHash(t->signedAmount(), static_cast<int>(t->getCategory()), t->getDescription())
+            ^ (t->getCurrency().value() * 0x9E3779B97F4A7C15ULL);
+    }
+
+    static string baseNameOf(const string& filename) {
+        size_t dot = filename.rfind('.');
+        return dot == string::npos ? filename : filename.substr(0, dot);
+    }
+
+    static string fingerprintFileFor(const string& filename) {
+        return baseNameOf(filename) + ".fpidx";
+    }
+
+    string segmentFileFor(int year) const {
+        return archiveBase + "." + to_string(year) + ".seg";
+    }
+
+    string summaryFile() const {
+        return archiveBase + ".segidx";
+    }
+
+    // Years of an archive whose new files are not all in place yet
+    string journalFile() const {
+        return archiveBase + ".segjournal";
+    }
+
+    static string pendingFile(const string& filename) {
+        return filename + ".new";
+    }
+
+    static bool replaceFile(const string& from, const string& to) {
+        error_code error;
+        filesystem::rename(from, to, error);
+        return !error;
+    }
+
+    // One transaction line of the data file; nullptr for an unknown type
+    Transaction* readTransaction(istream& file) const {
+        char type;
+        double amount;
+        string description, categoryStr;
+        int day, month, year;
         
-        double totalIncome = 0.0;
-        double totalExpense = 0.0;
-        map<Category, double> categoryExpenses;
+        file >> type >> amount;
+        file.ignore(); // Skip space
         
-        for (auto t : transactions) {
-            Date date = t->getDate();
-            if (date.toString().find("/" + to_string(month) + "/" + to_string(year)) != string::npos) {
-                if (t->getType() == "Income") {
-                    totalIncome += t->getAmount();
-                } else if (t->getType() == "Expenditure") {
-                    totalExpense += t->getAmount();
-                    categoryExpenses[t->getCategory()] += t->getAmount();
-                }
-            }
-        }
+        // Read description (spaces are stored encoded)
+        getline(file, description, ' ');
+        description = decodeField(description);
         
-        cout << "Total Income: " << fixed << setprecision(2) << totalIncome << endl;
-        cout << "Total Expenses: " << fixed << setprecision(2) << totalExpense << endl;
-        cout << "Net Savings: " << fixed << setprecision(2) << (totalIncome - totalExpense) << endl;
+        // Read date
+        file >> day >> month >> year;
+        Date date(day, month, year);
         
-        cout << "\nExpense Breakdown by Category:\n";
-        for (const auto& pair : categoryExpenses) {
-            cout << setw(20) << categoryToString(pair.first) << ": " << fixed << setprecision(2) << pair.second;
-            // Show percentage of total expenses
-            if (totalExpense > 0) {
-                cout << " (" << fixed << setprecision(1) << (pair.second / totalExpense * 100) << "%)";
-            }
-            cout << endl;
+        // Read category
+        file >> categoryStr;
+        
+        Category category = stringToCategory(categoryStr);
+        CurrencyCode currency = readCurrency(file);
+        
+        Transaction* t = nullptr;
+        if (type == 'I') {
+            t = new Income(amount, description, date, category);
+        } else if (type == 'E') {
+            t = new Expenditure(amount, description, date, category);
         }
+        if (t) t->setCurrency(currency);
+        return t;
     }
     
-    // Save data to file
-    bool saveToFile(const string& filename) {
-        ofstream file(filename);
-        if (!file.is_open()) {
-            return false;
-        }
-        
-        // Save transactions
-        file << transactions.size() << endl;
-        for (auto t : transactions) {
-            t->saveToFile(file);
+    // Optional currency code at the end of a record line; the base code if
+    // absent or if it names the base currency
+    CurrencyCode readCurrency(istream& file) const {
+        while (file.peek() == ' ' || file.peek() == '\t') file.get();
+        CurrencyCode code;
+        if (isalpha(file.peek())) {
+            string name;
+            file >> name;
+            CurrencyCode::parse(name, code);
         }
-        
-        // Save investments
-        file << investments.size() << endl;
-        for (auto i : investments) {
-            i->saveToFile(file);
+        return fx.normalize(code);
+    }
+
+    // Segment layout: count, then transaction lines as in the data file
+    ColdSegment readSegment(int year) const {
+        ColdSegment rows;
+        ifstream file(segmentFileFor(year));
+        size_t count;
+        if (!(file >> count)) return rows;
+        file.ignore();
+        rows.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            Transaction* t = readTransaction(file);
+            if (t) rows.emplace_back(t);
         }
-        
-        file.close();
-        return true;
+        return rows;
     }
-    
-    // Load data from file
-    bool loadFromFile(const string& filename, double& balance) {
-        ifstream file(filename);
-        if (!file.is_open()) {
+
+    // Appends rows to their year segments and updates the summaries. Any
+    // crash leaves either the old or the new state: the new segments and
+    // summaries are written next to the old ones, followed by a journal of
+    // the years; rewriting the data file without the rows commits the
+    // archive, and the new files are then renamed into place. The summaries
+    // in memory change only after all of it succeeded.
+    bool archiveRows(const vector<Transaction*>& rows, const string& filename, bool fingerprinted) {
+        if (unratedCold > 0) {
             return false;
         }
-        
-        // Clear existing data
-        for (auto t : transactions) delete t;
-        for (auto i : investments) delete i;
-        transactions.clear();
-        investments.clear();
-        
-        // Load transactions
-        int transactionCount;
-        file >> transactionCount;
-        file.ignore(); // Skip newline
-        
-        for (int i = 0; i < transactionCount; i++) {
-            char type;
-            double amount;
-            string description, categoryStr;
-            int day, month, year;
-            
-            file >> type >> amount;
-            file.ignore(); // Skip space
-            
-            // Read description (may contain spaces)
-            getline(file, description, ' ');
-            
-            // Read date
-            file >> day >> month >> year;
-            Date date(day, month, year);
-            
-            // Read category
-            file >> categoryStr;
-            
-            Category category = stringToCategory(categoryStr);
-            
-            if (type == 'I') {
-                transactions.push_back(new Income(amount, description, date, category));
-                balance += amount;
-            } else if (type == 'E') {
-                transactions.push_back(new Expenditure(amount, description, date, category));
-                balance -= amount;
+        map<int, vector<Transaction*>> byYear;
+        for (auto t : rows) {
+            if (!rated(t)) return false;
+            byYear[t->getDate().year].push_back(t);
+        }
+        SummaryIndex staged = coldSummaries;
+        vector<int> years;
+        bool written = true;
+        for (const auto& entry : byYear) {
+            int year = entry.first;
+            years.push_back(year);
+            ColdSegment existing = readSegment(year);
+            bool summarized = staged.find(year) != nullptr;
+            ofstream file(pendingFile(segmentFileFor(year)));
+            file << setprecision(15) << existing.size() + entry.second.size() << endl;
+            for (const auto& t : existing) {
+                t->saveToFile(file);
+            }
+            for (auto t : entry.second) {
+                t->saveToFile(file);
+            }
+            file.close();
+            if (!file) {
+                written = false;
+                break;
+            }
+            SegmentSummary& summary = staged.at(year);
+            if (!summarized) {
+                for (const auto& t : existing) {
+                    summary.add(t->getDate().month, baseSigned(t.get()), static_cast<int>(t->getCategory()));
+                }
+            }
+            for (auto t : entry.second) {
+                summary.add(t->getDate().month, baseSigned(t), static_cast<int>(t->getCategory()));
             }
         }
+        if (!written || !staged.saveToFile(pendingFile(summaryFile())) || !writeJournal(years)) {
+            discardArchive(years);
+            return false;
+        }
         
-        // Load investments
-        int investmentCount;
-        file >> investmentCount;
-        file.ignore(); // Skip newline
-        
-        for (int i = 0; i < investmentCount; i++) {
-            string type;
-            double amount;
-            int duration;
-            int day, month, year;
-            
-            file >> type >> amount >> duration;
-            file >> day >> month >> year;
-            Date startDate(day, month, year);
-            
-            if (type == "SIP") {
-                double monthly;
-                file >> monthly;
-                investments.push_back(new SIP(amount, duration, monthly, startDate));
-            } else if (type == "FD") {
-                investments.push_back(new FD(amount, duration, startDate));
+        // The commit: the data file without the archived rows
+        if (fingerprinted) {
+            for (auto t : rows) fingerprints.erase(fingerprintOf(t), t->getDate().toDayNumber());
+        }
+        if (!saveToFile(filename)) {
+            if (fingerprinted) {
+                for (auto t : rows) fingerprints.insert(fingerprintOf(t), t->getDate().toDayNumber());
             }
-            
-            balance -= amount; // Deduct investment amount from balance
+            discardArchive(years);
+            return false;
+        }
+        coldSummaries = staged;
+        installArchive(years);
+        for (int year : years) {
+            coldCache.invalidate(year);
         }
-        
-        file.close();
         return true;
     }
 
-    // Add new methods
-    void addUpcomingPayment(const Date& date, const std::string& desc, double amount, bool isInvestment = false) {
-        upcomingPayments.push(UpcomingPayment(date, desc, amount, isInvestment));
+    // Layout: "ARCHIVE <count> <years...> END"
+    bool writeJournal(const vector<int>& years) const {
+        ofstream file(journalFile());
+        file << "ARCHIVE " << years.size();
+        for (int year : years) file << " " << year;
+        file << " END" << endl;
+        file.close();
+        return static_cast<bool>(file);
     }
-    
-    void displayUpcomingPayments() {
-        auto tempQueue = upcomingPayments;
-        cout << "\n--UPCOMING PAYMENTS--\n";
-        cout << setw(12) << "Date" << setw(20) << "Description" << setw(15) << "Amount" << setw(15) << "Type" << endl;
-        cout << string(62, '-') << endl;
-        
-        while (!tempQueue.empty()) {
-            const auto& payment = tempQueue.top();
-            cout << setw(12) << payment.dueDate 
-                 << setw(20) << payment.description 
-                 << setw(15) << fixed << setprecision(2) << payment.amount
-                 << setw(15) << (payment.isInvestment ? "Investment" : "Payment") << endl;
-            tempQueue.pop();
+
+    // Returns 1 for a complete journal, 0 for one cut short and -1 if there is none
+    int readJournal(vector<int>& years) const {
+        ifstream file(journalFile());
+        if (!file.is_open()) return -1;
+        string tag;
+        size_t count;
+        if (!(file >> tag >> count) || tag != "ARCHIVE") return 0;
+        int year;
+        while (years.size() < count && file >> year) {
+            years.push_back(year);
         }
+        return years.size() == count && file >> tag && tag == "END" ? 1 : 0;
     }
-    
-    std::vector<std::string> getDescriptionSuggestions(const std::string& prefix) {
-        return descriptionTrie.getSuggestions(prefix);
+
+    // Puts the new files of a committed archive in place; renames already
+    // done before a crash are skipped
+    void installArchive(const vector<int>& years) {
+        for (int year : years) {
+            string pending = pendingFile(segmentFileFor(year));
+            if (ifstream(pending).good()) replaceFile(pending, segmentFileFor(year));
+        }
+        if (ifstream(pendingFile(summaryFile())).good()) {
+            replaceFile(pendingFile(summaryFile()), summaryFile());
+        }
+        remove(journalFile().c_str());
     }
-    
-    Transaction* findTransactionById(const std::string& id) {
-        return transactionIndex.getTransaction(id);
+
+    void discardArchive(const vector<int>& years) {
+        for (int year : years) {
+            remove(pendingFile(segmentFileFor(year)).c_str());
+        }
+        remove(pendingFile(summaryFile()).c_str());
+        remove(journalFile().c_str());
     }
-};
+
+    // Without a readable summary file, or after the exchange rates changed,
+    // the summaries are rebuilt from the segments found, including years that
+    // are hot again after --hot-years grew. They are not saved while any row
+    // lacks a rate.
+    void rebuildSummaries() {
+        coldSummaries.clear();
+        coldSummaries.setRates(fx.stamp());
+        unratedCold = 0;
+        for (int year = 1970; year <= Date().year; year++) {
+            ColdSegment rows = readSegment(year);
+            if (rows.empty()) continue;
+            SegmentSummary& summary = coldSummaries.at(year);
+            for (const auto& t : rows) {
+                if (!rated(t.get())) unratedCold++;
+                summary.add(t->getDate().month, baseSigned(t.get()), static_cast<int>(t->getCategory()));
+            }
+        }
+        unrated += unratedCold;
+        if (archiving && unratedCold == 0 && !coldSummaries.getYears().empty()) {
+            coldSummaries.saveToFile(summaryFile());
+        }
+    }
+
+    // Archived months go into the range index as one amount on the 1st
+    void addColdAggregates(const SegmentSummary& summary) {
+        for (int month = 1; month <= 12; month++) {
+            Date first(1, month, summary.year);
+            if (summary.income[month - 1] != 0) {
+                amounts.add(first, static_cast<int>(Category::INCOME), summary.income[month - 1]);
+            }
+            for (int c = 0; c < CATEGORY_COUNT; c++) {
+                double spent = summary.spend[(month - 1) * CATEGORY_COUNT + c];
+                if (spent != 0) amounts.add(first, c, -spent);
+            }
+        }
+    }
+
+    // The part of an archived month's aggregate dated after the given day, so
+    // range sums can be cut off exactly. Month ends need no correction; any
+    // other day in an archived year pages the year's rows in.
+    double coldAfter(const Date& date, int category) {
+        if (!coldSummaries.find(date.year) || date.day >= Date::daysInMonth(date.month, date.year)) {
+            return 0.0;
+        }
+        int day = date.toDayNumber();
+        double after = 0.0;
+        auto segment = coldCache.get(date.year);
+        for (const auto& t : *segment) {
+            Date d = t->getDate();
+            if (d.month == date.month && d.toDayNumber() > day &&
+                    (category < 0 || category == static_cast<int>(t->getCategory()))) {
+                after += baseSigned(t.get());
+            }
+        }
+        return after;
+    }
+
+    static Date dayBefore(const Date& date) {
+        return Date::fromDayNumber(date.toDayNumber() - 1);
+    }
+
+    void setDefaultRules() {
+        budgetRules.clearRules();
+        budgetRules.addRule(BudgetRule(RuleKind::MIN_BALANCE, RuleAction::BLOCK, BudgetRule::ANY_CATEGORY, 1000));
+    }
+
+public:
+    Ledger transactions;  // current version
+    vector<Investment*> investments;
+
+    static constexpr int DEFAULT_HOT_YEARS = 2;  // this year and last
+    static constexpr size_t DEFAULT_COLD_CACHE_ROWS = 100000;
+
+    FinanceManager()
+        : budgetRules(CATEGORY_COUNT), rateTable(RateTable::builtin()), amounts(CATEGORY_COUNT), nextRecurringId(1),
+          coldSummaries(CATEGORY_COUNT),
+          coldCache([this](int year) { return readSegment(year); }, DEFAULT_COLD_CACHE_ROWS),
+          hotYears(DEFAULT_HOT_YEARS), archiving(true), unrated(0), unratedCold(0) {
+        ledgerBase = fx.getBase();
+        setDefaultRules();
+    }
+    
+    // Off for loads that must only read (bulk restore): old years stay in
+    // memory, an interrupted archive fails the load, and nothing is written
+    void setArchiving(bool enabled) {
+        archiving = enabled;
+    }
+    
+    // Years kept in the data file; takes effect at the next load
+    void setHotYears(int years) {
+        hotYears = max(1, years);
+    }
+    
+    // Most archived rows kept in memory at once
+    void setColdCacheRows(size_t rows) {
+        coldCache.setBudget(rows);
+    }
+    
+    ~FinanceManager() {
+        // Clean up memory
+        for (auto t : records) {
+            delete t;
+        }
+        for (auto i : investments) {
+            delete i;
+        }
+    }
+
+    void addTransaction(Transaction* t) {
+        history.record(currentVersion());
+        appendTransaction(t);
+    }
+    
+    static string idForSlot(size_t slot) {
+        return "TXN" + to_string(slot + 1);
+    }
+    
+    // Slot of an id such as "TXN12", or -1
+    long slotForId(const string& id) const {
+        if (id.size() < 4 || id.compare(0, 3, "TXN") != 0) return -1;
+        char* end = nullptr;
+        long n = strtol(id.c_str() + 3, &end, 10);
+        if (*end != '\0' || n < 1 || static_cast<size_t>(n) > transactions.slotCount()) return -1;
+        return n - 1;
+    }
+    
+    // Replaces a transaction with a corrected copy; the old record stays
+    // reachable from earlier versions
+    bool replaceTransaction(size_t slot, Transaction* updated, double& balance) {
+        if (!transactions.at(slot)) return false;
+        history.record(currentVersion());
+        records.push_back(updated);
+        descriptionTrie.insert(updated->getDescription());
+        switchTo(transactions.replace(slot, updated), balance);
+        return true;
+    }
+    
+    bool removeTransaction(size_t slot, double& balance) {
+        if (!transactions.at(slot)) return false;
+        history.record(currentVersion());
+        switchTo(transactions.replace(slot, nullptr), balance);
+        return true;
+    }
+    
+    bool undo(double& balance) {
+        if (!history.canUndo()) return false;
+        switchTo(history.undo(currentVersion()), balance);
+        return true;
+    }
+    
+    bool redo(double& balance) {
+        if (!history.canRedo()) return false;
+        switchTo(history.redo(currentVersion()), balance);
+        return true;
+    }
+    
+    // Checkpoints are kept for the session; the data file holds the current version
+    void saveCheckpoint(const string& name) {
+        history.checkpoint(name, currentVersion());
+    }
+    
+    const Ledger* findCheckpoint(const string& name) const {
+        const LedgerVersion* version = history.find(name);
+        return version ? &version->ledger : nullptr;
+    }
+    
+    vector<string> getCheckpointNames() const {
+        vector<string> names;
+        for (const auto& entry : history.getCheckpoints()) {
+            names.push_back(entry.first);
+        }
+        return names;
+    }
+    
+    // Going back to a checkpoint is itself an edit that can be undone
+    bool restoreCheckpoint(const string& name, double& balance) {
+        const LedgerVersion* version = history.find(name);
+        if (!version) return false;
+        LedgerVersion target = *version;
+        history.record(currentVersion());
+        switchTo(target, balance);
+        return true;
+    }
+    
+    // Slots that differ between an earlier version and the current one
+    void displayChanges(const Ledger& since) const {
+        OutputBuffer out(cout);
+        size_t changes = 0;
+        since.diff(transactions, [&](size_t slot, Transaction* before, Transaction* after) {
+            const char* mark = !before ? "+ " : !after ? "- " : "~ ";
+            out.append(mark);
+            out.field(idForSlot(slot), 10);
+            (after ? after : before)->render(out);
+            if (before && after) {
+                out.append("  was ");
+                out.field("", 6);
+                before->render(out);
+            }
+            changes++;
+        });
+        if (changes == 0) {
+            out.append("No changes.\n");
+        }
+    }
+    
+    // The most recent transactions with their ids, newest first
+    void displayRecent(size_t count) const {
+        OutputBuffer out(cout);
+        out.field("ID", 12);
+        renderTransactionHeader(out);
+        for (size_t slot = transactions.slotCount(); slot > 0 && count > 0; slot--) {
+            Transaction* t = transactions.at(slot - 1);
+            if (!t) continue;
+            out.field(idForSlot(slot - 1), 12);
+            t->render(out);
+            count--;
+        }
+    }
+    
+    // True if the same amount, category and description was already recorded
+    // within the duplicate window of this transaction's date
+    bool isDuplicate(const Transaction* t) const {
+        return fingerprints.contains(fingerprintOf(t), t->getDate().toDayNumber());
+    }
+    
+    void setDuplicateWindow(int days) {
+        fingerprints.setWindowDays(days);
+    }
+    
+    int getDuplicateWindow() const {
+        return fingerprints.getWindowDays();
+    }
+
+    void addInvestment(Investment* i) {
+        i->attachRates(rateTable);
+        investments.push_back(i);
+        amounts.add(i->getStartDate(), -1, -investedBase(i));
+    }
+    
+    // Amount invested, in the base currency at the start date's rate
+    double investedBase(const Investment* i) const {
+        return fx.toBase(i->getCurrency(), i->getStartDate().toDayNumber(), i->getAmount());
+    }
+    
+    // Exchange rates; load them before the ledger so its totals convert
+    int loadFxTable(const string& filename) {
+        return fx.loadFromFile(filename);
+    }
+    
+    // Interest and exchange rates read once for many ledgers (bulk restore);
+    // copies share the built tables
+    void setRateTables(const RateTable& rates, const FxTable& exchange) {
+        rateTable = rates;
+        fx = exchange;
+        for (auto i : investments) {
+            i->attachRates(rateTable);
+        }
+    }
+    
+    // Base currency of the last data file read; differs from the exchange
+    // rate table's when the load was refused for that reason
+    CurrencyCode getLedgerBase() const {
+        return ledgerBase;
+    }
+    
+    // Transactions of the last load in currencies without exchange rates
+    size_t unratedCount() const {
+        return unrated;
+    }
+    
+    const FxTable& getFx() const {
+        return fx;
+    }
+    
+    double toBase(CurrencyCode code, const Date& date, double amount) const {
+        return fx.toBase(code, date.toDayNumber(), amount);
+    }
+    
+    // Replaces the built-in SIP/FD rates with the ones in the file, if present
+    int loadRateTable(const string& filename) {
+        int loaded = rateTable.loadFromFile(filename);
+        for (auto i : investments) {
+            i->attachRates(rateTable);
+        }
+        return loaded;
+    }
+    
+    // Total value of all holdings on a date, in the base currency at that
+    // date's rates; each one is two table lookups plus one for its currency
+    double portfolioValue(const Date& on) const {
+        double total = 0.0;
+        for (auto i : investments) {
+            total += toBase(i->getCurrency(), on, i->valueAt(on));
+        }
+        return total;
+    }
+
+    void displayRecord(double balance, const ListingOptions& opts = ListingOptions()) {
+        OutputBuffer out(cout);
+        out.append("-----------------------------------\n");
+        out.append("|        Personal Finance        |\n");
+        out.append("-----------------------------------\n");
+
+        out.append("\n||--BALANCE--: ");
+        out.field(balance, 0, 2);
+        out.append("||\n");
+
+        out.append("\n--SAVINGS--: \n");
+        renderTransactionHeader(out);
+        vector<Transaction*> candidates;
+        vector<shared_ptr<const ColdSegment>> pinned;  // archived rows being listed
+        if (opts.hasDateRange()) {
+            candidates.reserve(transactions.size());
+            for (const auto& entry : coldSummaries.getYears()) {
+                int year = entry.first;
+                if (Date(31, 12, year).toDayNumber() < opts.fromDay || Date(1, 1, year).toDayNumber() > opts.toDay) {
+                    continue;
+                }
+                pinned.push_back(coldCache.get(year));
+                for (const auto& t : *pinned.back()) {
+                    int day = t->getDate().toDayNumber();
+                    if (day >= opts.fromDay && day <= opts.toDay) candidates.push_back(t.get());
+                }
+            }
+            byDate.forEachInRange(opts.fromDay, opts.toDay, [&](int, Transaction* t) { candidates.push_back(t); });
+        } else {
+            candidates = transactions.toVector();
+        }
+        size_t total = candidates.size();
+        vector<Transaction*> rows = selectWindow(std::move(candidates), opts, transactionLess(opts.sortKey));
+        size_t shown = 0;
+        for (auto t : rows) {
+            if (opts.pageSize > 0 && shown > 0 && shown % opts.pageSize == 0) {
+                out.flush();
+                if (!promptNextPage(opts.offset + shown, total)) {
+                    break;
+                }
+                renderTransactionHeader(out);
+            }
+            t->render(out);
+            shown++;
+        }
+        if (rows.size() < total) {
+            out.append("(showing ");
+            out.field(static_cast<long long>(opts.offset + (shown > 0 ? 1 : 0)), 0);
+            out.append("-");
+            out.field(static_cast<long long>(opts.offset + shown), 0);
+            out.append(" of ");
+            out.field(static_cast<long long>(total), 0);
+            out.append(" transactions)\n");
+        }
+
+        if (!coldSummaries.getYears().empty()) {
+            size_t archivedRows = 0;
+            for (const auto& entry : coldSummaries.getYears()) {
+                archivedRows += entry.second.count;
+            }
+            out.append("(");
+            out.field(static_cast<long long>(archivedRows), 0);
+            out.append(" older transactions archived in ");
+            out.field(static_cast<long long>(coldSummaries.getYears().size()), 0);
+            out.append(" yearly segments; list them with --from/--to)\n");
+        }
+
+        out.append("\n--INVESTMENTS--\n");
+        renderInvestmentHeader(out);
+        for (auto i : investments) {
+            i->render(out);
+        }
+    }
+    
+    static void renderTransactionHeader(OutputBuffer& out) {
+        out.field("Type", 15);
+        out.field("Date", 12);
+        out.field("Amount", 15);
+        out.field("Category", 15);
+        out.field("Description", 20);
+        out.newline();
+        out.repeat('-', 77);
+        out.newline();
+    }
+    
+    static void renderInvestmentHeader(OutputBuffer& out) {
+        out.field("Type", 15);
+        out.field("Amount", 15);
+        out.field("Duration", 15);
+        out.field("Start Date", 15);
+        out.field("Monthly amount", 20);
+        out.newline();
+        out.repeat('-', 80);
+        out.newline();
+    }
+    
+    // Ordering used by --sort; ties keep no particular order
+    static function<bool(const Transaction*, const Transaction*)> transactionLess(SortKey key) {
+        switch (key) {
+            case SortKey::DATE:
+                return [](const Transaction* a, const Transaction* b) { return a->getDate() < b->getDate(); };
+            case SortKey::AMOUNT:
+                return [](const Transaction* a, const Transaction* b) { return a->getAmount() < b->getAmount(); };
+            case SortKey::CATEGORY:
+                return [](const Transaction* a, const Transaction* b) { return a->getCategory() < b->getCategory(); };
+            case SortKey::DESCRIPTION:
+                return [](const Transaction* a, const Transaction* b) { return a->getDescription() < b->getDescription(); };
+            default:
+                return [](const Transaction*, const Transaction*) { return false; };
+        }
+    }
+    
+    // Waits for Enter between pages; 'q' stops the listing
+    static bool promptNextPage(size_t shown, size_t total) {
+        cout << "-- " << shown << "/" << total << " -- Enter for next page, q to stop: ";
+        string line;
+        if (!getline(cin, line)) {
+            return false;
+        }
+        return line.empty() || (line[0] != 'q' && line[0] != 'Q');
+    }
+    
+    // Generate monthly report
+    void generateMonthlyReport(int month, int year) {
+        generateMonthlyReport(month, year, transactions);
+    }
+    
+    // Transactions of a ledger version dated from `from` to `to` (day numbers).
+    // The current version is read from the date-ordered store and only the
+    // chunks overlapping the range are touched; older versions are scanned.
+    template <typename F>
+    void forEachInRange(const Ledger& ledger, int from, int to, F fn) const {
+        if (ledger.sameAs(transactions)) {
+            byDate.forEachInRange(from, to, [&](int, Transaction* t) { fn(t); });
+            return;
+        }
+        ledger.forEach([&](Transaction* t) {
+            int day = t->getDate().toDayNumber();
+            if (day >= from && day <= to) fn(t);
+        });
+    }
+    
+    // Report over any version of the ledger, e.g. a checkpoint
+    void generateMonthlyReport(int month, int year, const Ledger& ledger) {
+        cout << "\n----- Monthly Report for " << month << "/" << year << " -----\n";
+        
+        double totalIncome = 0.0;
+        double totalExpense = 0.0;
+        map<Category, double> categoryExpenses;
+        
+        int monthStart = Date(1, month, year).toDayNumber();
+        int monthEnd = Date(Date::daysInMonth(month, year), month, year).toDayNumber();
+        
+        // Base rows are summed as they are read; the others are converted
+        // together afterwards, one rate lookup per currency and day
+        vector<uint16_t> foreignCodes;
+        vector<int32_t> foreignDays;
+        vector<double> foreignAmounts;
+        vector<const Transaction*> foreignRows;
+        forEachInRange(ledger, monthStart, monthEnd, [&](Transaction* t) {
+            if (!t->getCurrency().isBase()) {
+                foreignCodes.push_back(t->getCurrency().value());
+                foreignDays.push_back(t->getDate().toDayNumber());
+                foreignAmounts.push_back(t->getAmount());
+                foreignRows.push_back(t);
+            } else if (t->signedAmount() >= 0) {
+                totalIncome += t->getAmount();
+            } else {
+                totalExpense += t->getAmount();
+                categoryExpenses[t->getCategory()] += t->getAmount();
+            }
+        });
+        fx.convert(foreignCodes.data(), foreignDays.data(), foreignAmounts.data(), foreignAmounts.size());
+        for (size_t i = 0; i < foreignRows.size(); i++) {
+            if (foreignRows[i]->signedAmount() >= 0) {
+                totalIncome += foreignAmounts[i];
+            } else {
+                totalExpense += foreignAmounts[i];
+                categoryExpenses[foreignRows[i]->getCategory()] += foreignAmounts[i];
+            }
+        }
+        
+        // Archived months come from the year summary without reading rows
+        if (const SegmentSummary* summary = coldSummaries.find(year)) {
+            totalIncome += summary->income[month - 1];
+            totalExpense += summary->expense[month - 1];
+            for (int c = 0; c < CATEGORY_COUNT; c++) {
+                double spent = summary->spend[(month - 1) * CATEGORY_COUNT + c];
+                if (spent != 0) categoryExpenses[static_cast<Category>(c)] += spent;
+            }
+        }
+        
+        cout << "Total Income: " << fixed << setprecision(2) << totalIncome << endl;
+        cout << "Total Expenses: " << fixed << setprecision(2) << totalExpense << endl;
+        cout << "Net Savings: " << fixed << setprecision(2) << (totalIncome - totalExpense) << endl;
+        
+        // Recurring occurrences in this month that have not been posted yet
+        double scheduledIncome = 0.0;
+        double scheduledExpense = 0.0;
+        for (const auto& rule : recurring) {
+            rule.forEachOccurrence(max(monthStart, rule.postedThrough + 1), monthEnd, [&](int) {
+                (rule.isIncome ? scheduledIncome : scheduledExpense) += rule.amount;
+            });
+        }
+        if (scheduledIncome > 0 || scheduledExpense > 0) {
+            cout << "Scheduled recurring income: " << fixed << setprecision(2) << scheduledIncome << endl;
+            cout << "Scheduled recurring expenses: " << fixed << setprecision(2) << scheduledExpense << endl;
+        }
+        
+        cout << "\nExpense Breakdown by Category:\n";
+        for (const auto& pair : categoryExpenses) {
+            cout << setw(20) << categoryToString(pair.first) << ": " << fixed << setprecision(2) << pair.second;
+            // Show percentage of total expenses
+            if (totalExpense > 0) {
+                cout << " (" << fixed << setprecision(1) << (pair.second / totalExpense * 100) << "%)";
+            }
+            cout << endl;
+        }
+    }
+    
+    // Column layout of each exported table. Transaction ids are the n of
+    // TXN<n>, or 0 for archived transactions. Transaction and investment
+    // amounts are in their own currency; aggregates are in the base currency
+    // and have one spending column per category (expenditures filed under
+    // Income count only in the expense total).
+    static const vector<ColumnSpec>& exportColumns(ExportTable table) {
+        static const vector<ColumnSpec> transactionColumns = {
+            {"id", ColumnType::INT64}, {"date", ColumnType::DATE32}, {"type", ColumnType::STRING},
+            {"category", ColumnType::STRING}, {"amount", ColumnType::FLOAT64}, {"currency", ColumnType::STRING},
+            {"description", ColumnType::STRING}};
+        static const vector<ColumnSpec> investmentColumns = {
+            {"type", ColumnType::STRING}, {"amount", ColumnType::FLOAT64}, {"currency", ColumnType::STRING},
+            {"duration_years", ColumnType::INT32}, {"start_date", ColumnType::DATE32}, {"monthly", ColumnType::FLOAT64},
+            {"maturity_date", ColumnType::DATE32}, {"maturity_amount", ColumnType::FLOAT64}};
+        static const vector<string> spendNames = [] {
+            vector<string> names;
+            for (int c = 1; c < CATEGORY_COUNT; c++) {
+                names.push_back("spend_" + toLower(categoryToString(static_cast<Category>(c))));
+            }
+            return names;
+        }();
+        static const vector<ColumnSpec> aggregateColumns = [] {
+            vector<ColumnSpec> columns = {
+                {"year", ColumnType::INT32}, {"month", ColumnType::INT32}, {"income", ColumnType::FLOAT64},
+                {"expense", ColumnType::FLOAT64}, {"net", ColumnType::FLOAT64}};
+            for (const auto& name : spendNames) {
+                columns.push_back({name.c_str(), ColumnType::FLOAT64});
+            }
+            return columns;
+        }();
+        switch (table) {
+            case ExportTable::INVESTMENTS: return investmentColumns;
+            case ExportTable::AGGREGATES: return aggregateColumns;
+            default: return transactionColumns;
+        }
+    }
+    
+    // Writes a table to a file in batches, straight from the in-memory
+    // structures; the format follows the file extension. Archived years are
+    // read one segment at a time through the cold cache.
+    bool exportTable(ExportTable table, const string& filename, size_t& rows) {
+        ofstream file(filename, ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        const vector<ColumnSpec>& columns = exportColumns(table);
+        if (exportFormatFor(filename) == ExportFormat::NDJSON) {
+            NdjsonWriter writer(file, columns);
+            writeTable(table, writer);
+            rows = writer.rowCount();
+            return writer.finish();
+        }
+        ColumnarWriter writer(file, columns);
+        writeTable(table, writer);
+        rows = writer.rowCount();
+        return writer.finish();
+    }
+    
+    template <typename Writer>
+    void writeTable(ExportTable table, Writer& writer) {
+        switch (table) {
+            case ExportTable::TRANSACTIONS: writeTransactions(writer); break;
+            case ExportTable::INVESTMENTS: writeInvestments(writer); break;
+            case ExportTable::AGGREGATES: writeAggregates(writer); break;
+        }
+    }
+    
+    // Archived years first, then the current version in id order
+    template <typename Writer>
+    void writeTransactions(Writer& writer) {
+        static const vector<string> categoryNames = [] {
+            vector<string> names;
+            for (int c = 0; c < CATEGORY_COUNT; c++) names.push_back(categoryToString(static_cast<Category>(c)));
+            return names;
+        }();
+        auto write = [&](long long id, const Transaction* t) {
+            writer.int64(id);
+            writer.date(t->getDate().toDayNumber());
+            writer.string(t->signedAmount() < 0 ? "Expenditure" : "Income");
+            writer.string(categoryNames[static_cast<int>(t->getCategory())]);
+            writer.float64(t->getAmount());
+            writeCurrency(writer, t->getCurrency());
+            writer.string(t->getDescription());
+            writer.endRow();
+        };
+        for (const auto& entry : coldSummaries.getYears()) {
+            auto segment = coldCache.get(entry.first);
+            for (const auto& t : *segment) {
+                write(0, t.get());
+            }
+        }
+        transactions.forEachSlot([&](size_t slot, Transaction* t) {
+            write(static_cast<long long>(slot) + 1, t);
+        });
+    }
+    
+    template <typename Writer>
+    void writeCurrency(Writer& writer, CurrencyCode code) {
+        char name[3];
+        writer.string(name, (code.isBase() ? fx.getBase() : code).write(name));
+    }
+    
+    template <typename Writer>
+    void writeInvestments(Writer& writer) {
+        for (auto inv : investments) {
+            SIP* sip = dynamic_cast<SIP*>(inv);
+            writer.string(sip ? "SIP" : "FD");
+            writer.float64(inv->getAmount());
+            writeCurrency(writer, inv->getCurrency());
+            writer.int32(inv->getDuration());
+            writer.date(inv->getStartDate().toDayNumber());
+            writer.float64(sip ? sip->getMonthly() : 0.0);
+            writer.date(inv->maturityDate().toDayNumber());
+            writer.float64(inv->maturityAmount());
+            writer.endRow();
+        }
+    }
+    
+    // One row per month with any activity. Hot rows are summed in one pass
+    // over the date-ordered store; archived months come from the summaries
+    // and are merged in month order.
+    template <typename Writer>
+    void writeAggregates(Writer& writer) {
+        vector<int> coldMonths;  // month indexes with archived activity
+        for (const auto& entry : coldSummaries.getYears()) {
+            const SegmentSummary& summary = entry.second;
+            for (int m = 1; m <= 12; m++) {
+                if (summary.income[m - 1] != 0 || summary.expense[m - 1] != 0) {
+                    coldMonths.push_back(Date(1, m, summary.year).monthIndex());
+                }
+            }
+        }
+        size_t nextCold = 0;
+        int current = INT_MIN;
+        double income = 0.0;
+        double expense = 0.0;
+        vector<double> spend(CATEGORY_COUNT, 0.0);
+        
+        auto emit = [&]() {
+            writer.int32(current / 12);
+            writer.int32(current % 12 + 1);
+            writer.float64(income);
+            writer.float64(expense);
+            writer.float64(income - expense);
+            for (int c = 1; c < CATEGORY_COUNT; c++) writer.float64(spend[c]);
+            writer.endRow();
+            income = expense = 0.0;
+            fill(spend.begin(), spend.end(), 0.0);
+        };
+        auto addCold = [&](int monthIndex) {
+            const SegmentSummary& summary = *coldSummaries.find(monthIndex / 12);
+            int m = monthIndex % 12;
+            income += summary.income[m];
+            expense += summary.expense[m];
+            for (int c = 0; c < CATEGORY_COUNT; c++) spend[c] += summary.spend[m * CATEGORY_COUNT + c];
+        };
+        // Emits the month being summed and any archived months before the next one
+        auto startMonth = [&](int monthIndex) {
+            if (monthIndex == current) return;
+            if (current != INT_MIN) emit();
+            for (; nextCold < coldMonths.size() && coldMonths[nextCold] < monthIndex; nextCold++) {
+                current = coldMonths[nextCold];
+                addCold(current);
+                emit();
+            }
+            current = monthIndex;
+            if (nextCold < coldMonths.size() && coldMonths[nextCold] == monthIndex) {
+                addCold(coldMonths[nextCold++]);
+            }
+        };
+        
+        byDate.forEachInRange(INT_MIN, INT_MAX, [&](int, Transaction* t) {
+            startMonth(t->getDate().monthIndex());
+            double value = baseAmount(t);
+            if (t->signedAmount() >= 0) {
+                income += value;
+            } else {
+                expense += value;
+                spend[static_cast<int>(t->getCategory())] += value;
+            }
+        });
+        startMonth(INT_MAX);
+    }
+    
+    // Save data to file
+    // Written to a new file that then replaces the old one, so a crash while
+    // saving leaves the previous version in place
+    bool saveToFile(const string& filename) {
+        string pending = pendingFile(filename);
+        ofstream file(pending);
+        if (!file.is_open()) {
+            return false;
+        }
+        file << setprecision(15);
+        
+        // Amounts without a code are in the base currency
+        file << "BASE " << fx.getBase().toString() << endl;
+        
+        // Save transactions
+        file << transactions.size() << endl;
+        transactions.forEach([&](Transaction* t) {
+            t->saveToFile(file);
+        });
+        
+        // Save investments
+        file << investments.size() << endl;
+        for (auto i : investments) {
+            i->saveToFile(file);
+        }
+        
+        // Save budget rules
+        const auto& rules = budgetRules.getRules();
+        file << "RULES " << rules.size() << endl;
+        for (const auto& rule : rules) {
+            file << "R " << ruleKindToString(rule.kind) << " " << (rule.action == RuleAction::BLOCK ? "BLOCK" : "ALERT")
+                 << " " << ruleCategoryToString(rule.category) << " " << rule.limit << " " << rule.windowDays << endl;
+        }
+        
+        // Save recurrence rules (never their occurrences)
+        file << "REC " << recurring.size() << endl;
+        for (const auto& rule : recurring) {
+            Date end = rule.endDay == RecurrenceRule::NO_END ? Date(0, 0, 0) : Date::fromDayNumber(rule.endDay);
+            file << "C " << recurrenceKindToString(rule.kind) << " " << rule.interval << " ";
+            file << rule.anchor;
+            file << " ";
+            file << end;
+            file << " ";
+            file << Date::fromDayNumber(rule.postedThrough);
+            file << " " << rule.dayOfMonth << " " << rule.amount << " " << (rule.isIncome ? "I" : "E") << " "
+                 << categoryToString(static_cast<Category>(rule.category)) << " " << encodeField(rule.description) << endl;
+        }
+        
+        file.close();
+        if (!file || !replaceFile(pending, filename)) {
+            remove(pending.c_str());
+            return false;
+        }
+        fingerprints.saveToFile(fingerprintFileFor(filename), transactions.size(), FingerprintIndex::hashFile(filename));
+        return true;
+    }
+    
+    // Load data from file
+    bool loadFromFile(const string& filename, double& balance) {
+        ledgerBase = fx.getBase();
+        ifstream file(filename);
+        if (!file.is_open()) {
+            return false;
+        }
+        return loadFromStream(file, filename, FingerprintIndex::hashFile(filename), balance);
+    }
+    
+    // Same as loadFromFile for a data file already read into memory (bulk restore)
+    bool loadFromBuffer(const char* data, size_t size, const string& filename, double& balance) {
+        MemoryStream file(data, size);
+        return loadFromStream(file, filename, FingerprintIndex::hashBytes(data, size), balance);
+    }
+    
+    // The filename locates the side files (fingerprints, archived years);
+    // dataHash is the hash of the file's bytes
+    bool loadFromStream(istream& file, const string& filename, uint64_t dataHash, double& balance) {
+        // Clear existing data
+        for (auto t : records) delete t;
+        for (auto i : investments) delete i;
+        records.clear();
+        transactions = Ledger();
+        history.clear();
+        transactionIndex.clear();
+        investments.clear();
+        budgetRules.clearCounters();
+        amounts.clear();
+        byDate.clear();
+        
+        archiveBase = baseNameOf(filename);
+        coldCache.clear();
+        unrated = 0;
+        unratedCold = 0;
+        int firstHotYear = Date().year - hotYears + 1;
+        
+        // Amounts without a code are in the file's base currency, the
+        // default one in older files. A ledger kept in another base than
+        // fx.txt names is refused rather than silently re-denominated.
+        CurrencyCode::parse(FxTable::DEFAULT_BASE, ledgerBase);
+        file >> ws;
+        if (file.peek() == 'B') {
+            string tag, name;
+            file >> tag >> name;
+            if (tag != "BASE" || !CurrencyCode::parse(name, ledgerBase)) {
+                return false;
+            }
+        }
+        if (ledgerBase != fx.getBase()) {
+            return false;
+        }
+        
+        // An archive cut short by a crash was committed if the data file no
+        // longer has rows of its years (other than rows without a rate,
+        // which are never archived)
+        vector<int> journaled;
+        int journal = readJournal(journaled);
+        bool journaledRows = false;
+        
+        // Load transactions
+        int transactionCount;
+        file >> transactionCount;
+        file.ignore(); // Skip newline
+        
+        // The saved fingerprint table is used as is when it matches the ledger
+        fingerprints.clear();
+        bool haveFingerprints = fingerprints.loadFromFile(fingerprintFileFor(filename), transactionCount, dataHash);
+        
+        vector<Transaction*> cold;
+        for (int i = 0; i < transactionCount; i++) {
+            Transaction* t = readTransaction(file);
+            if (!t) {
+                continue;
+            }
+            if (!journaledRows && rated(t) &&
+                    find(journaled.begin(), journaled.end(), t->getDate().year) != journaled.end()) {
+                journaledRows = true;
+            }
+            if (!rated(t)) {
+                unrated++;
+            } else if (t->getDate().year < firstHotYear) {
+                cold.push_back(t);
+                continue;
+            }
+            indexTransaction(t);
+            if (!haveFingerprints) {
+                fingerprints.insert(fingerprintOf(t), t->getDate().toDayNumber());
+            }
+            balance += baseSigned(t);
+        }
+        
+        if (journal >= 0 && !archiving) {
+            for (auto t : cold) delete t;
+            return false;
+        }
+        if (journal == 1 && !journaledRows) {
+            installArchive(journaled);
+        } else if (journal >= 0) {
+            discardArchive(journaled);
+        }
+        
+        // Archived years: only their summaries are read here, unless they
+        // were converted at other exchange rates
+        if (!coldSummaries.loadFromFile(summaryFile()) || coldSummaries.getRates() != fx.stamp()) {
+            rebuildSummaries();
+        }
+        
+        // Load investments
+        int investmentCount;
+        file >> investmentCount;
+        file.ignore(); // Skip newline
+        
+        for (int i = 0; i < investmentCount; i++) {
+            string type;
+            double amount;
+            int duration;
+            int day, month, year;
+            
+            file >> type >> amount >> duration;
+            file >> day >> month >> year;
+            Date startDate(day, month, year);
+            
+            Investment* investment = nullptr;
+            if (type == "SIP") {
+                double monthly;
+                file >> monthly;
+                investment = new SIP(amount, duration, monthly, startDate);
+            } else if (type == "FD") {
+                investment = new FD(amount, duration, startDate);
+            }
+            CurrencyCode currency = readCurrency(file);
+            if (investment) {
+                investment->setCurrency(currency);
+                addInvestment(investment);
+            }
+            
+            balance -= toBase(currency, startDate, amount); // Deduct investment amount from balance
+        }
+        
+        // Optional sections, absent in older files
+        string section;
+        size_t count;
+        while (file >> section >> count) {
+            if (section == "RULES") {
+                budgetRules.clearRules();
+                for (size_t i = 0; i < count; i++) {
+                    string tag, kind, action, categoryStr;
+                    double limit;
+                    int window;
+                    file >> tag >> kind >> action >> categoryStr >> limit >> window;
+                    budgetRules.addRule(BudgetRule(stringToRuleKind(kind), action == "BLOCK" ? RuleAction::BLOCK : RuleAction::ALERT,
+                                                   stringToRuleCategory(categoryStr), limit, window));
+                }
+            } else if (section == "REC") {
+                recurring.clear();
+                for (size_t i = 0; i < count; i++) {
+                    string tag, kind, incomeFlag, categoryStr, description;
+                    int interval, dayOfMonth;
+                    double amount;
+                    Date anchor, end, posted;
+                    file >> tag >> kind >> interval;
+                    file >> anchor;
+                    file >> end;
+                    file >> posted;
+                    file >> dayOfMonth >> amount >> incomeFlag >> categoryStr >> description;
+                    RecurrenceRule rule(stringToRecurrenceKind(kind), interval, anchor, amount, decodeField(description),
+                                        static_cast<int>(stringToCategory(categoryStr)), incomeFlag == "I",
+                                        end.year == 0 ? RecurrenceRule::NO_END : end.toDayNumber());
+                    rule.dayOfMonth = dayOfMonth;
+                    rule.postedThrough = posted.toDayNumber();
+                    addRecurring(rule);
+                }
+            }
+        }
+        
+        // Rows that went cold move to their segments, and the data file is
+        // rewritten without them; if any step fails they stay hot
+        bool archived = archiving && !cold.empty() && archiveRows(cold, filename, haveFingerprints);
+        for (auto t : cold) {
+            if (archived) {
+                delete t;
+            } else {
+                indexTransaction(t);
+                if (!haveFingerprints) {
+                    fingerprints.insert(fingerprintOf(t), t->getDate().toDayNumber());
+                }
+                balance += baseSigned(t);
+            }
+        }
+        for (const auto& entry : coldSummaries.getYears()) {
+            addColdAggregates(entry.second);
+            balance += entry.second.netTotal();
+        }
+        return true;
+    }
+
+    // Add new methods
+    void addUpcomingPayment(const Date& date, const std::string& desc, double amount, bool isInvestment = false) {
+        upcomingPayments.push(UpcomingPayment(date, desc, amount, isInvestment));
+    }
+    
+    // The queue already yields payments by due date and recurring items are
+    // expanded one occurrence at a time, so only the rows up to the end of the
+    // window are produced and formatted. Without --limit, recurring items are
+    // shown for the next UPCOMING_HORIZON_DAYS days.
+    static const int UPCOMING_HORIZON_DAYS = 90;
+    
+    void displayUpcomingPayments(const ListingOptions& opts = ListingOptions()) {
+        auto tempQueue = upcomingPayments;
+        int horizon = opts.limit > 0 ? RecurrenceRule::NO_END : Date().toDayNumber() + UPCOMING_HORIZON_DAYS;
+        size_t end = opts.limit > 0 ? opts.offset + opts.limit : numeric_limits<size_t>::max();
+        
+        // Next unposted occurrence of every recurring rule, earliest first
+        typedef pair<int, size_t> Pending;
+        priority_queue<Pending, vector<Pending>, greater<Pending>> nextRecurring;
+        for (size_t r = 0; r < recurring.size(); r++) {
+            int day = recurring[r].nextUnposted();
+            if (day <= horizon) {
+                nextRecurring.push(Pending(day, r));
+            }
+        }
+        
+        OutputBuffer out(cout);
+        out.append("\n--UPCOMING PAYMENTS--\n");
+        out.field("Date", 12);
+        out.field("Description", 20);
+        out.field("Amount", 15);
+        out.field("Type", 15);
+        out.newline();
+        out.repeat('-', 62);
+        out.newline();
+        
+        for (size_t row = 0; row < end && (!tempQueue.empty() || !nextRecurring.empty()); row++) {
+            bool fromQueue = !tempQueue.empty() &&
+                (nextRecurring.empty() || tempQueue.top().dueDate.toDayNumber() <= nextRecurring.top().first);
+            if (fromQueue) {
+                const auto& payment = tempQueue.top();
+                if (row >= opts.offset) {
+                    out.field(payment.dueDate, 12);
+                    out.field(payment.description, 20);
+                    out.field(payment.amount, 15, 2);
+                    out.field(payment.isInvestment ? "Investment" : "Payment", 15);
+                    out.newline();
+                }
+                tempQueue.pop();
+            } else {
+                Pending next = nextRecurring.top();
+                nextRecurring.pop();
+                const RecurrenceRule& rule = recurring[next.second];
+                if (row >= opts.offset) {
+                    out.field(Date::fromDayNumber(next.first), 12);
+                    out.field(rule.description, 20);
+                    out.field(rule.amount, 15, 2);
+                    out.field(rule.isIncome ? "Recurring in" : "Recurring", 15);
+                    out.newline();
+                }
+                int following = rule.occurrenceDay(rule.firstIndexFrom(next.first + 1));
+                if (following <= horizon && following <= rule.endDay) {
+                    nextRecurring.push(Pending(following, next.second));
+                }
+            }
+        }
+    }
+    
+    // Recurring transactions
+    const vector<RecurrenceRule>& getRecurring() const {
+        return recurring;
+    }
+    
+    void addRecurring(const RecurrenceRule& rule) {
+        recurring.push_back(rule);
+        recurring.back().id = nextRecurringId++;
+    }
+    
+    bool removeRecurring(size_t index) {
+        if (index >= recurring.size()) return false;
+        recurring.erase(recurring.begin() + index);
+        return true;
+    }
+    
+    // Posts every occurrence due on or before today that has not been posted
+    // yet and moves the watermark; returns the number of transactions added.
+    // Budget rules are not checked (the payments happen regardless), but the
+    // posted expenses count towards their limits.
+    int postDueRecurring(const Date& today, double& balance) {
+        int todayNumber = today.toDayNumber();
+        int posted = 0;
+        // One undo step for the whole run, watermarks included
+        for (const auto& rule : recurring) {
+            if (rule.nextUnposted() <= todayNumber) {
+                history.record(currentVersion());
+                break;
+            }
+        }
+        for (auto& rule : recurring) {
+            if (rule.postedThrough >= todayNumber) continue;
+            Category category = static_cast<Category>(rule.category);
+            rule.forEachOccurrence(rule.postedThrough + 1, todayNumber, [&](int day) {
+                Date date = Date::fromDayNumber(day);
+                if (rule.isIncome) {
+                    appendTransaction(new Income(rule.amount, rule.description, date, category));
+                } else {
+                    appendTransaction(new Expenditure(rule.amount, rule.description, date, category));
+                }
+                balance += rule.signedAmount();
+                posted++;
+            });
+            rule.postedThrough = todayNumber;
+        }
+        return posted;
+    }
+    
+    // Day-by-day balance projection from the given balance: upcoming payments,
+    // unposted recurring occurrences, SIP monthly contributions and investment
+    // maturity payouts, each landing on its date
+    ForecastTimeline buildForecast(const Date& from, int years, double balance) {
+        int first = from.toDayNumber();
+        Date until(from.day, from.month, from.year + years);
+        int last = Date(min(until.day, Date::daysInMonth(until.month, until.year)), until.month, until.year).toDayNumber();
+        ForecastTimeline timeline(first, last - first + 1, balance);
+        
+        auto pending = upcomingPayments;
+        while (!pending.empty()) {
+            timeline.addEvent(pending.top().dueDate.toDayNumber(), -pending.top().amount);
+            pending.pop();
+        }
+        
+        for (const auto& rule : recurring) {
+            rule.forEachOccurrence(max(first, rule.postedThrough + 1), last, [&](int day) {
+                timeline.addEvent(day, rule.signedAmount());
+            });
+        }
+        
+        for (auto inv : investments) {
+            Date start = inv->getStartDate();
+            int maturity = inv->maturityDate().toDayNumber();
+            SIP* sip = dynamic_cast<SIP*>(inv);
+            if (sip) {
+                // Contributions are due monthly on the start day, from the month after the start until maturity
+                RecurrenceRule contributions(RecurrenceKind::MONTHLY, 1, start, sip->getMonthly(), "", 0, false, maturity);
+                contributions.forEachOccurrence(max(first, start.toDayNumber() + 1), last, [&](int day) {
+                    timeline.addEvent(day, -fx.toBase(inv->getCurrency(), day, sip->getMonthly()));
+                });
+            }
+            if (maturity >= first) {
+                timeline.addEvent(maturity, fx.toBase(inv->getCurrency(), maturity, inv->maturityAmount()));
+            }
+        }
+        
+        timeline.build();
+        return timeline;
+    }
+    
+    // Limit of the first minimum balance rule, or the given fallback
+    double minimumBalance(double fallback) const {
+        for (const auto& rule : budgetRules.getRules()) {
+            if (rule.kind == RuleKind::MIN_BALANCE) return rule.limit;
+        }
+        return fallback;
+    }
+    
+    // Balance at the end of a day. The opening balance is whatever the
+    // current balance has on top of all recorded flows, so backdated entries
+    // are accounted for without replaying the ledger.
+    double balanceOn(const Date& date, double currentBalance) {
+        return currentBalance - amounts.totalAmount() + amounts.upTo(date) - coldAfter(date, -1);
+    }
+    
+    // Net flow (income minus spending and investments) in a date range
+    double netFlowBetween(const Date& from, const Date& to) {
+        return amounts.between(from, to) - coldAfter(to, -1) + coldAfter(dayBefore(from), -1);
+    }
+    
+    // Total of a category in a date range, as a positive amount
+    double categoryTotalBetween(Category category, const Date& from, const Date& to) {
+        int c = static_cast<int>(category);
+        return fabs(amounts.categoryBetween(c, from, to) - coldAfter(to, c) + coldAfter(dayBefore(from), c));
+    }
+    
+    // Category number for a query, by name in any case; -1 if unknown
+    static int queryCategory(const string& name) {
+        string wanted = toLower(name);
+        for (int c = 0; c < CATEGORY_COUNT; c++) {
+            if (toLower(categoryToString(static_cast<Category>(c))) == wanted) return c;
+        }
+        return -1;
+    }
+    
+    static bool compileQuery(const string& text, Query& query, string& error) {
+        return query.compile(text, queryCategory, error);
+    }
+    
+    // Runs a query over the current ledger, archived years included, in
+    // batches of rows, with amounts converted to the base currency. Only the
+    // hot chunks and archived years inside the query's dates, narrowed to
+    // [fromDay, toDay], are read. fn(batch, sel, n, archived) is called with
+    // the matching rows of each batch (sources are Transaction pointers);
+    // archived rows are only valid during the call, since their segment may
+    // leave the cache afterwards.
+    template <typename F>
+    QueryResult runQuery(const Query& query, F fn, int fromDay = INT_MIN, int toDay = INT_MAX) {
+        int from = max(query.fromDay(), fromDay);
+        int to = min(query.toDay(), toDay);
+        QueryResult result;
+        bool archived = false;
+        unique_ptr<RowBatch> batch(new RowBatch());
+        vector<uint16_t> sel(RowBatch::CAPACITY);
+        auto flush = [&]() {
+            fx.convert(batch->currency, batch->day, batch->amount, batch->size);
+            size_t n = query.select(*batch, sel.data());
+            query.aggregate(*batch, sel.data(), n, result);
+            if (n > 0) fn(*batch, sel.data(), n, archived);
+            batch->size = 0;
+        };
+        auto add = [&](const Transaction* t) {
+            batch->push(t->getDate(), static_cast<int>(t->getCategory()), t->signedAmount() >= 0, t->getAmount(),
+                        t->getCurrency().value(), &t->getDescription(), t);
+            if (batch->full()) flush();
+        };
+        
+        if (from > to) return result;
+        archived = true;
+        for (const auto& entry : coldSummaries.getYears()) {
+            int year = entry.first;
+            if (Date(31, 12, year).toDayNumber() < from || Date(1, 1, year).toDayNumber() > to) {
+                continue;
+            }
+            auto segment = coldCache.get(year);
+            for (const auto& t : *segment) {
+                int day = t->getDate().toDayNumber();
+                if (day >= from && day <= to) add(t.get());
+            }
+            flush();
+        }
+        archived = false;
+        byDate.forEachInRange(from, to, [&](int, Transaction* t) { add(t); });
+        flush();
+        return result;
+    }
+    
+    QueryResult runQuery(const Query& query, int fromDay = INT_MIN, int toDay = INT_MAX) {
+        return runQuery(query, [](const RowBatch&, const uint16_t*, size_t, bool) {}, fromDay, toDay);
+    }
+    
+    // Copy of an archived row that can outlive its segment in the cache
+    static Transaction* copyOf(const Transaction* t) {
+        Transaction* copy;
+        if (t->signedAmount() >= 0) {
+            copy = new Income(t->getAmount(), t->getDescription(), t->getDate(), t->getCategory());
+        } else {
+            copy = new Expenditure(t->getAmount(), t->getDescription(), t->getDate(), t->getCategory());
+        }
+        copy->setCurrency(t->getCurrency());
+        return copy;
+    }
+    
+    // Grouped queries print one line per group; others list the matching
+    // transactions with the listing options, then the totals. --from/--to
+    // narrow the query's own dates. Unsorted listings are printed as the rows
+    // are found; sorted ones keep only the rows up to the end of the window
+    // when there is a limit, with archived rows copied, so no segment has to
+    // stay in the cache.
+    void displayQuery(const Query& query, const ListingOptions& opts = ListingOptions()) {
+        OutputBuffer out(cout);
+        if (query.groupKey() != GroupKey::NONE) {
+            QueryResult result = runQuery(query, opts.fromDay, opts.toDay);
+            out.field("Group", 15);
+            out.field("Count", 10);
+            out.field("Income", 15);
+            out.field("Expenses", 15);
+            out.field("Net", 15);
+            out.newline();
+            out.repeat('-', 70);
+            out.newline();
+            for (const auto& group : result.groups) {
+                out.field(groupLabel(result.key, group.first), 15);
+                renderTotals(out, group.second);
+            }
+            out.repeat('-', 70);
+            out.newline();
+            out.field("Total", 15);
+            renderTotals(out, result.total);
+            return;
+        }
+        
+        QueryResult result;
+        size_t total = 0;
+        size_t shown = 0;
+        auto show = [&](const Transaction* t) {
+            if (opts.pageSize > 0 && shown > 0 && shown % opts.pageSize == 0) {
+                out.flush();
+                if (!promptNextPage(opts.offset + shown, total)) {
+                    return false;
+                }
+                renderTransactionHeader(out);
+            }
+            t->render(out);
+            shown++;
+            return true;
+        };
+        
+        if (opts.sortKey == SortKey::NONE) {
+            // The page prompt shows the total, so it is counted first
+            if (opts.pageSize > 0) {
+                total = static_cast<size_t>(runQuery(query, opts.fromDay, opts.toDay).total.count);
+            }
+            renderTransactionHeader(out);
+            size_t index = 0;
+            bool stopped = false;
+            result = runQuery(query, [&](const RowBatch& batch, const uint16_t* sel, size_t n, bool) {
+                for (size_t i = 0; i < n && !stopped; i++, index++) {
+                    if (index < opts.offset || (opts.limit > 0 && index >= opts.offset + opts.limit)) continue;
+                    stopped = !show(static_cast<const Transaction*>(batch.source[sel[i]]));
+                }
+            }, opts.fromDay, opts.toDay);
+        } else {
+            typedef shared_ptr<const Transaction> Row;
+            auto less = transactionLess(opts.sortKey);
+            auto rowLess = [&](const Row& a, const Row& b) { return less(a.get(), b.get()); };
+            auto displayOrder = [&](const Row& a, const Row& b) {
+                return opts.descending ? less(b.get(), a.get()) : less(a.get(), b.get());
+            };
+            size_t keep = opts.limit > 0 ? opts.offset + opts.limit : 0;
+            vector<Row> kept;
+            result = runQuery(query, [&](const RowBatch& batch, const uint16_t* sel, size_t n, bool archived) {
+                for (size_t i = 0; i < n; i++) {
+                    const Transaction* t = static_cast<const Transaction*>(batch.source[sel[i]]);
+                    kept.push_back(archived ? Row(copyOf(t)) : Row(t, [](const Transaction*) {}));
+                }
+                // Rows past the end of the window can never be shown
+                if (keep > 0 && kept.size() >= 2 * keep + RowBatch::CAPACITY) {
+                    nth_element(kept.begin(), kept.begin() + keep, kept.end(), displayOrder);
+                    kept.resize(keep);
+                }
+            }, opts.fromDay, opts.toDay);
+            total = static_cast<size_t>(result.total.count);
+            renderTransactionHeader(out);
+            for (const auto& row : selectWindow(std::move(kept), opts, rowLess)) {
+                if (!show(row.get())) break;
+            }
+        }
+        total = static_cast<size_t>(result.total.count);
+        out.newline();
+        out.field(static_cast<long long>(total), 0);
+        out.append(" matching transaction(s): income ");
+        out.field(result.total.income, 0, 2);
+        out.append(", expenses ");
+        out.field(result.total.expense, 0, 2);
+        out.append(", net ");
+        out.field(result.total.net(), 0, 2);
+        out.newline();
+    }
+    
+    static string groupLabel(GroupKey key, int64_t group) {
+        switch (key) {
+            case GroupKey::MONTH: return to_string(group % 12 + 1) + "/" + to_string(group / 12);
+            case GroupKey::CATEGORY: return categoryToString(static_cast<Category>(group));
+            case GroupKey::TYPE: return group ? "Income" : "Expenditure";
+            default: return to_string(group);
+        }
+    }
+    
+    static void renderTotals(OutputBuffer& out, const QueryTotals& totals) {
+        out.field(static_cast<long long>(totals.count), 10);
+        out.field(totals.income, 15, 2);
+        out.field(totals.expense, 15, 2);
+        out.field(totals.net(), 15, 2);
+        out.newline();
+    }
+    
+    // Bulk import: rows go straight into the ledger in one batch. Rows
+    // without a known category get one from earlier transactions with the
+    // same description, or from keywords in the description. Rows matching
+    // a transaction recorded before this import are skipped as duplicates;
+    // identical rows within the same statement are kept. Like recurring
+    // posts, imported rows are not checked against budget rules since they
+    // have already happened; they still count towards the limits.
+    size_t importRows(const vector<ImportedRow>& rows, double& balance, size_t& duplicates) {
+        unordered_map<string, Category> learned;
+        transactions.forEach([&](Transaction* t) {
+            learned[toLower(t->getDescription())] = t->getCategory();
+        });
+        // Statements repeat the same descriptions, so each one is classified once
+        unordered_map<string, Category> resolved;
+        
+        vector<Transaction*> batch;
+        batch.reserve(rows.size());
+        duplicates = 0;
+        for (const auto& row : rows) {
+            double amount = fabs(row.amount);
+            Transaction* t;
+            if (row.amount >= 0) {
+                t = new Income(amount, row.description, row.date, Category::INCOME);
+            } else {
+                Category category = row.category.empty() ? Category::OTHER : stringToCategory(row.category);
+                if (category == Category::OTHER && row.category != "Other") {
+                    auto it = resolved.find(row.description);
+                    if (it == resolved.end()) {
+                        it = resolved.emplace(row.description, guessCategory(row.description, learned)).first;
+                    }
+                    category = it->second;
+                }
+                t = new Expenditure(amount, row.description, row.date, category);
+            }
+            if (isDuplicate(t)) {
+                delete t;
+                duplicates++;
+            } else {
+                batch.push_back(t);
+            }
+        }
+        
+        // The whole statement is one version, undone in one step
+        if (!batch.empty()) {
+            history.record(currentVersion());
+        }
+        records.reserve(records.size() + batch.size());
+        for (auto t : batch) {
+            appendTransaction(t);
+            balance += baseSigned(t);
+        }
+        return batch.size();
+    }
+    
+    static string toLower(const string& str) {
+        string out(str);
+        for (char& c : out) {
+            c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        }
+        return out;
+    }
+    
+    static Category guessCategory(const string& description, const unordered_map<string, Category>& learned) {
+        static const pair<const char*, Category> keywords[] = {
+            {"grocer", Category::FOOD}, {"restaurant", Category::FOOD}, {"cafe", Category::FOOD},
+            {"food", Category::FOOD}, {"swiggy", Category::FOOD}, {"zomato", Category::FOOD},
+            {"rent", Category::HOUSING}, {"mortgage", Category::HOUSING}, {"maintenance", Category::HOUSING},
+            {"fuel", Category::TRANSPORTATION}, {"petrol", Category::TRANSPORTATION}, {"uber", Category::TRANSPORTATION},
+            {"ola", Category::TRANSPORTATION}, {"metro", Category::TRANSPORTATION}, {"taxi", Category::TRANSPORTATION},
+            {"movie", Category::ENTERTAINMENT}, {"netflix", Category::ENTERTAINMENT}, {"spotify", Category::ENTERTAINMENT},
+            {"electric", Category::UTILITIES}, {"water", Category::UTILITIES}, {"internet", Category::UTILITIES},
+            {"mobile", Category::UTILITIES}, {"gas", Category::UTILITIES},
+            {"pharma", Category::HEALTHCARE}, {"hospital", Category::HEALTHCARE}, {"clinic", Category::HEALTHCARE},
+            {"doctor", Category::HEALTHCARE},
+            {"school", Category::EDUCATION}, {"tuition", Category::EDUCATION}, {"course", Category::EDUCATION},
+            {"book", Category::EDUCATION},
+        };
+        string lower = toLower(description);
+        auto it = learned.find(lower);
+        if (it != learned.end() && it->second != Category::INCOME) {
+            return it->second;
+        }
+        for (const auto& keyword : keywords) {
+            if (lower.find(keyword.first) != string::npos) {
+                return keyword.second;
+            }
+        }
+        return Category::OTHER;
+    }
+    
+    std::vector<std::string> getDescriptionSuggestions(const std::string& prefix) {
+        return descriptionTrie.getSuggestions(prefix);
+    }
+    
+    Transaction* findTransactionById(const std::string& id) {
+        return transactionIndex.getTransaction(id);
+    }
+    
+    // Budget rules
+    const vector<BudgetRule>& getBudgetRules() const {
+        return budgetRules.getRules();
+    }
+    
+    void addBudgetRule(const BudgetRule& rule) {
+        budgetRules.addRule(rule);
+    }
+    
+    bool removeBudgetRule(size_t index) {
+        return budgetRules.removeRule(index);
+    }
+    
+    vector<RuleViolation> checkExpense(Category category, const Date& date, double amount) {
+        return budgetRules.evaluateExpense(static_cast<int>(category), date, amount);
+    }
+    
+    vector<RuleViolation> checkBalance(double balanceAfter) {
+        vector<RuleViolation> violations;
+        budgetRules.evaluateBalance(balanceAfter, violations);
+        return violations;
+    }
+    
+    // Prints the violations; returns true if any of them blocks the operation
+    bool reportViolations(const vector<RuleViolation>& violations) {
+        const auto& rules = budgetRules.getRules();
+        for (const auto& v : violations) {
+            const BudgetRule& rule = rules[v.ruleIndex];
+            cout << (rule.action == RuleAction::BLOCK ? "Error: " : "Warning: ") << describeRule(rule)
+                 << " (would be " << fixed << setprecision(2) << v.projected << ")" << endl;
+        }
+        return BudgetRuleEngine::blocks(rules, violations);
+    }
+    
+    void displayBudgetRules() {
+        const auto& rules = budgetRules.getRules();
+        Date today;
+        cout << "\n--BUDGET RULES--\n";
+        if (rules.empty()) {
+            cout << "No rules defined.\n";
+            return;
+        }
+        for (size_t i = 0; i < rules.size(); i++) {
+            cout << i + 1 << ". " << describeRule(rules[i]);
+            if (rules[i].kind != RuleKind::MIN_BALANCE) {
+                cout << " [used " << fixed << setprecision(2) << budgetRules.usage(i, today) << "]";
+            }
+            cout << endl;
+        }
+    }
+    
+    static string describeRule(const BudgetRule& rule) {
+        ostringstream os;
+        os << fixed << setprecision(2);
+        os << (rule.action == RuleAction::BLOCK ? "[block] " : "[alert] ");
+        switch (rule.kind) {
+            case RuleKind::CATEGORY_CAP:
+                os << ruleCategoryToString(rule.category) << " spend capped at " << rule.limit << " per month";
+                break;
+            case RuleKind::ROLLING_WINDOW:
+                os << ruleCategoryToString(rule.category) << " spend limited to " << rule.limit << " over " << rule.windowDays << " days";
+                break;
+            case RuleKind::MIN_BALANCE:
+                os << "Balance cannot go below " << rule.limit;
+                break;
+        }
+        return os.str();
+    }
+    
+    static string ruleKindToString(RuleKind kind) {
+        switch (kind) {
+            case RuleKind::CATEGORY_CAP: return "CAP";
+            case RuleKind::ROLLING_WINDOW: return "WINDOW";
+            default: return "MINBAL";
+        }
+    }
+    
+    static RuleKind stringToRuleKind(const string& str) {
+        if (str == "CAP") return RuleKind::CATEGORY_CAP;
+        if (str == "WINDOW") return RuleKind::ROLLING_WINDOW;
+        return RuleKind::MIN_BALANCE;
+    }
+    
+    static string ruleCategoryToString(int category) {
+        return category == BudgetRule::ANY_CATEGORY ? "All" : categoryToString(static_cast<Category>(category));
+    }
+    
+    static int stringToRuleCategory(const string& str) {
+        return str == "All" ? BudgetRule::ANY_CATEGORY : static_cast<int>(stringToCategory(str));
+    }
+};
 
 class User {
 public:
+    static constexpr const char* RATES_FILE = "rates.txt";
+    static constexpr const char* FX_FILE = "fx.txt";
+
     FinanceManager manager;
     double balance;
     string username;
     string dataFile;
+    ListingOptions listing;
+    bool readOnly;  // nothing is archived, posted or saved (exports)
+    bool refused;   // the data file could not be used as it is
 
-    User(double initialBalance, const string& name = "default") {
+    User(double initialBalance, const string& name = "default", int hotYears = FinanceManager::DEFAULT_HOT_YEARS,
+         bool onlyRead = false) {
         balance = initialBalance;
         username = name;
         dataFile = username + "_finance_data.txt";
+        readOnly = onlyRead;
+        refused = false;
+        manager.setHotYears(hotYears);
+        manager.setArchiving(!readOnly);
+        
+        if (manager.loadRateTable(RATES_FILE) > 0) {
+            cout << "Loaded interest rates from " << RATES_FILE << ".\n";
+        }
+        if (manager.loadFxTable(FX_FILE) > 0) {
+            cout << "Loaded exchange rates for " << manager.getFx().currencyCount() << " currencies from " << FX_FILE << ".\n";
+        }
         
         // Try to load existing data
         if (!manager.loadFromFile(dataFile, balance)) {
+            if (manager.getLedgerBase() != manager.getFx().getBase()) {
+                cout << "The data for " << username << " is kept in " << manager.getLedgerBase().toString() << ", but "
+                     << FX_FILE << " names " << manager.getFx().getBase().toString()
+                     << " as the base currency. Nothing was loaded or changed.\n";
+                readOnly = true;
+                refused = true;
+                return;
+            }
             cout << "No existing data found. Starting with a fresh account.\n";
         } else {
             cout << "Loaded existing data for " << username << ".\n";
         }
+        if (manager.unratedCount() > 0) {
+            cout << manager.unratedCount() << " transaction(s) in currencies without rates in " << FX_FILE
+                 << " count at face value and are not archived.\n";
+        }
+        
+        if (readOnly) {
+            return;
+        }
+        int posted = manager.postDueRecurring(Date(), balance);
+        if (posted > 0) {
+            cout << "Posted " << posted << " due recurring transaction(s).\n";
+        }
     }
     
     ~User() {
         // Save data when user object is destroyed
-        saveData();
+        if (!readOnly) {
+            saveData();
+        }
     }
     
     bool saveData() {
@@ -530,6 +2460,13 @@ public:
             cout << "6. Monthly Report\n";
             cout << "7. Save Data\n";
             cout << "8. Add upcoming payment\n";
+            cout << "9. Budget rules\n";
+            cout << "10. Cash-flow forecast\n";
+            cout << "11. Import bank statement (CSV/OFX)\n";
+            cout << "12. Balance and date-range queries\n";
+            cout << "13. Edit, undo and checkpoints\n";
+            cout << "14. Export data for analysis\n";
+            cout << "15. Query transactions\n";
             cout << "0. Exit\n";
             cout << "Enter choice : ";
             
@@ -545,20 +2482,33 @@ public:
                 case 1: {
                     double amt;
                     string desc;
-                    cout << "Enter amount : ";
+                    CurrencyCode currency;
+                    cout << "Enter amount" << currencyHint() << " : ";
                     while (!(cin >> amt) || amt <= 0) {
                         cin.clear();
                         cin.ignore(numeric_limits<streamsize>::max(), '\n');
                         cout << "Invalid amount. Please enter a positive number: ";
                     }
+                    if (!readCurrencySuffix(currency)) {
+                        system("pause");
+                        break;
+                    }
                     
                     cout << "Enter description : ";
                     cin.ignore();
                     getline(cin, desc);
                     
-                    manager.addTransaction(new Income(amt, desc));
-                    balance += amt;
-                    cout << "\nIncome of " << fixed << setprecision(2) << amt << " recorded successfully!\n";
+                    Transaction* income = new Income(amt, desc);
+                    income->setCurrency(currency);
+                    if (manager.isDuplicate(income) && !confirmDuplicate()) {
+                        delete income;
+                        cout << "Income not recorded.\n";
+                        system("pause");
+                        break;
+                    }
+                    manager.addTransaction(income);
+                    balance += manager.toBase(currency, Date(), amt);
+                    cout << "\nIncome of " << fixed << setprecision(2) << amt << currencySuffix(currency) << " recorded successfully!\n";
                     cout << "\n\n\n\n";
                     system("pause");
                     break;
@@ -568,16 +2518,21 @@ public:
                     double amt;
                     string desc;
                     Category category;
+                    CurrencyCode currency;
                     
-                    cout << "Enter amount: ";
+                    cout << "Enter amount" << currencyHint() << ": ";
                     while (!(cin >> amt) || amt <= 0) {
                         cin.clear();
                         cin.ignore(numeric_limits<streamsize>::max(), '\n');
                         cout << "Invalid amount. Please enter a positive number: ";
                     }
+                    if (!readCurrencySuffix(currency)) {
+                        system("pause");
+                        break;
+                    }
+                    double baseAmt = manager.toBase(currency, Date(), amt);
                     
-                    if (balance - amt < 1000) {
-                        cout << "Error: Balance cannot go below 1000." << endl;
+                    if (manager.reportViolations(manager.checkBalance(balance - baseAmt))) {
                         system("pause");
                         break;
                     }
@@ -616,9 +2571,23 @@ public:
                         default: category = Category::OTHER; break;
                     }
                     
-                    manager.addTransaction(new Expenditure(amt, desc, category));
-                    balance -= amt;
-                    cout << "\nExpenditure of " << fixed << setprecision(2) << amt << " recorded successfully!\n";
+                    if (manager.reportViolations(manager.checkExpense(category, Date(), baseAmt))) {
+                        cout << "Expenditure not recorded.\n";
+                        system("pause");
+                        break;
+                    }
+                    
+                    Transaction* expense = new Expenditure(amt, desc, category);
+                    expense->setCurrency(currency);
+                    if (manager.isDuplicate(expense) && !confirmDuplicate()) {
+                        delete expense;
+                        cout << "Expenditure not recorded.\n";
+                        system("pause");
+                        break;
+                    }
+                    manager.addTransaction(expense);
+                    balance -= baseAmt;
+                    cout << "\nExpenditure of " << fixed << setprecision(2) << amt << currencySuffix(currency) << " recorded successfully!\n";
                     cout << "\n\n\n\n";
                     system("pause");
                     break;
@@ -632,7 +2601,10 @@ public:
                 }
 
                 case 4: {
-                    manager.displayRecord(balance);
+                    if (listing.pageSize > 0) {
+                        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                    }
+                    manager.displayRecord(balance, listing);
                     cout << "\n\n\n\n";
                     system("pause");
                     break;
@@ -643,13 +2615,24 @@ public:
                     if (manager.investments.empty()) {
                         cout << "No investments found.\n";
                     } else {
+                        OutputBuffer out(cout);
+                        Date today;
                         for (size_t i = 0; i < manager.investments.size(); i++) {
                             Investment* inv = manager.investments[i];
-                            cout << "\nInvestment " << i + 1 << " : " << fixed << setprecision(2) << inv->maturityAmount() << " Rs" << endl;
-                            cout << setw(15) << "Type" << setw(15) << "Amount" << setw(15) << "Duration" << setw(15) << "Start Date" << setw(20) << "Monthly amount" << endl;
-                            cout << string(80, '-') << endl;
-                            inv->display();
+                            out.append("\nInvestment ");
+                            out.field(static_cast<long long>(i + 1), 0);
+                            out.append(" : ");
+                            string label = currencyLabel(inv->getCurrency());
+                            out.field(inv->maturityAmount(), 0, 2);
+                            out.append(" " + label + " (value today ");
+                            out.field(inv->valueAt(today), 0, 2);
+                            out.append(" " + label + ")\n");
+                            FinanceManager::renderInvestmentHeader(out);
+                            inv->render(out);
                         }
+                        out.append("\nPortfolio value today: ");
+                        out.field(manager.portfolioValue(today), 0, 2);
+                        out.append(" " + currencyLabel(CurrencyCode()) + "\n");
                     }
                     cout << "\n\n\n\n";
                     system("pause");
@@ -693,6 +2676,9 @@ public:
                     cout << "\n1. Add upcoming payment\n";
                     cout << "2. View upcoming payments\n";
                     cout << "3. Search transactions\n";
+                    cout << "4. Add recurring transaction\n";
+                    cout << "5. View recurring transactions\n";
+                    cout << "6. Remove recurring transaction\n";
                     cout << "Enter choice: ";
                     
                     int subChoice;
@@ -717,7 +2703,7 @@ public:
                             break;
                         }
                         case 2: {
-                            manager.displayUpcomingPayments();
+                            manager.displayUpcomingPayments(listing);
                             break;
                         }
                         case 3: {
@@ -733,12 +2719,81 @@ public:
                             }
                             break;
                         }
+                        case 4: {
+                            addRecurring();
+                            break;
+                        }
+                        case 5: {
+                            displayRecurring();
+                            break;
+                        }
+                        case 6: {
+                            displayRecurring();
+                            size_t index;
+                            cout << "Enter number to remove: ";
+                            if (cin >> index && index >= 1 && manager.removeRecurring(index - 1)) {
+                                cout << "Recurring transaction removed.\n";
+                            } else {
+                                cin.clear();
+                                cout << "No such recurring transaction.\n";
+                            }
+                            break;
+                        }
                     }
                     cout << "\n\n\n\n";
                     system("pause");
                     break;
                 }
 
+                case 9: {
+                    budgetRuleMenu();
+                    cout << "\n\n\n\n";
+                    system("pause");
+                    break;
+                }
+
+                case 10: {
+                    forecastMenu();
+                    cout << "\n\n\n\n";
+                    system("pause");
+                    break;
+                }
+
+                case 11: {
+                    importMenu();
+                    cout << "\n\n\n\n";
+                    system("pause");
+                    break;
+                }
+
+                case 12: {
+                    rangeQueryMenu();
+                    cout << "\n\n\n\n";
+                    system("pause");
+                    break;
+                }
+
+                case 13: {
+                    historyMenu();
+                    cout << "\n\n\n\n";
+                    system("pause");
+                    break;
+                }
+
+                case 14: {
+                    exportMenu();
+                    cout << "\n\n\n\n";
+                    system("pause");
+                    break;
+                }
+
+                case 15: {
+                    queryMenu();
+                    cout << "\n\n\n\n";
+                    system("pause");
+                    break;
+                }
+
                 case 0:
                     saveData();
                     cout << "Thank you for using the Finance Management System!\n";
@@ -753,6 +2808,551 @@ public:
         }
     }
 
+    void addRecurring() {
+        int kindChoice, income, every, catChoice = 8;
+        double amt;
+        string desc;
+        int day, month, year;
+        
+        cout << "Repeat 1. Weekly  2. Monthly  3. Yearly : ";
+        while (!(cin >> kindChoice) || kindChoice < 1 || kindChoice > 3) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid choice. Please enter 1, 2 or 3: ";
+        }
+        cout << "Every how many periods (1 = every period): ";
+        while (!(cin >> every) || every <= 0) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid number. Please enter a positive number: ";
+        }
+        cout << "1. Income  0. Expenditure : ";
+        while (!(cin >> income)) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid input. Please enter 1 or 0: ";
+        }
+        cout << "Enter amount: ";
+        while (!(cin >> amt) || amt <= 0) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid amount. Please enter a positive number: ";
+        }
+        cin.ignore();
+        cout << "Enter description: ";
+        getline(cin, desc);
+        if (!income) {
+            cout << "Category (1-8 as in expenditure): ";
+            while (!(cin >> catChoice) || catChoice < 1 || catChoice > 8) {
+                cin.clear();
+                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                cout << "Invalid choice. Please enter a number between 1 and 8: ";
+            }
+        }
+        cout << "Enter first date (day month year): ";
+        while (!(cin >> day >> month >> year) || !Date(day, month, year).isValid()) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid date. Please enter day month year: ";
+        }
+        
+        RecurrenceKind kind = kindChoice == 1 ? RecurrenceKind::WEEKLY : kindChoice == 2 ? RecurrenceKind::MONTHLY : RecurrenceKind::YEARLY;
+        Category category = income ? Category::INCOME : static_cast<Category>(catChoice);
+        manager.addRecurring(RecurrenceRule(kind, every, Date(day, month, year), amt, desc, static_cast<int>(category), income != 0));
+        cout << "Recurring transaction added.\n";
+        
+        int posted = manager.postDueRecurring(Date(), balance);
+        if (posted > 0) {
+            cout << "Posted " << posted << " occurrence(s) already due.\n";
+        }
+    }
+    
+    void displayRecurring() {
+        const auto& rules = manager.getRecurring();
+        cout << "\n--RECURRING TRANSACTIONS--\n";
+        if (rules.empty()) {
+            cout << "None.\n";
+            return;
+        }
+        for (size_t i = 0; i < rules.size(); i++) {
+            const auto& rule = rules[i];
+            int next = rule.nextUnposted();
+            cout << i + 1 << ". " << rule.description << " " << (rule.isIncome ? "+" : "-") << fixed << setprecision(2) << rule.amount
+                 << " " << recurrenceKindToString(rule.kind) << (rule.interval > 1 ? " x" + to_string(rule.interval) : "")
+                 << ", next: " << (next == RecurrenceRule::NO_END ? string("none") : Date::fromDayNumber(next).toString()) << endl;
+        }
+    }
+    
+    void forecastMenu() {
+        int years;
+        cout << "Forecast horizon in years (1-30): ";
+        while (!(cin >> years) || years < 1 || years > 30) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid horizon. Please enter a number between 1 and 30: ";
+        }
+        
+        double minimum = manager.minimumBalance(0.0);
+        ForecastTimeline timeline = manager.buildForecast(Date(), years, balance);
+        displayForecast(timeline, minimum);
+        
+        while (true) {
+            double amt;
+            int day, month, year;
+            cout << "\nWhat-if: enter amount (negative = spend) and date (day month year), or 0 to stop: ";
+            if (!(cin >> amt) || amt == 0) {
+                cin.clear();
+                break;
+            }
+            if (!(cin >> day >> month >> year) || !Date(day, month, year).isValid()) {
+                cin.clear();
+                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                cout << "Invalid date.\n";
+                continue;
+            }
+            timeline.applyDelta(Date(day, month, year).toDayNumber(), amt);
+            displayForecast(timeline, minimum);
+        }
+    }
+    
+    void displayForecast(const ForecastTimeline& timeline, double minimum) {
+        int lowDay;
+        double low = timeline.lowestBalance(lowDay);
+        int breach = timeline.firstBreach(minimum);
+        
+        OutputBuffer out(cout);
+        out.append("\n--FORECAST--\n");
+        out.append("Ending balance on ");
+        out.field(Date::fromDayNumber(timeline.getEndDay()), 0);
+        out.append(": ");
+        out.field(timeline.balanceOn(timeline.getEndDay()), 0, 2);
+        out.append("\nLowest balance: ");
+        out.field(low, 0, 2);
+        out.append(" on ");
+        out.field(Date::fromDayNumber(lowDay), 0);
+        out.append("\nFirst drop below ");
+        out.field(minimum, 0, 2);
+        out.append(": ");
+        if (breach == ForecastTimeline::NO_BREACH) {
+            out.append("never");
+        } else {
+            out.field(Date::fromDayNumber(breach), 0);
+        }
+        out.append("\n\n");
+        out.field("Year end", 12);
+        out.field("Balance", 15);
+        out.newline();
+        out.repeat('-', 27);
+        out.newline();
+        Date start = Date::fromDayNumber(timeline.getStartDay());
+        Date end = Date::fromDayNumber(timeline.getEndDay());
+        for (int year = start.year; year <= end.year; year++) {
+            int day = min(Date(31, 12, year).toDayNumber(), timeline.getEndDay());
+            out.field(Date::fromDayNumber(day), 12);
+            out.field(timeline.balanceOn(day), 15, 2);
+            out.newline();
+        }
+    }
+    
+    static Date readDate(const string& prompt) {
+        int day, month, year;
+        cout << prompt;
+        while (!(cin >> day >> month >> year) || !Date(day, month, year).isValid()) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid date. Please enter day month year: ";
+        }
+        return Date(day, month, year);
+    }
+    
+    void rangeQueryMenu() {
+        cout << "\n1. Balance on a date\n";
+        cout << "2. Category total between two dates\n";
+        cout << "3. Net flow between two dates\n";
+        cout << "Enter choice: ";
+        
+        int subChoice;
+        if (!(cin >> subChoice)) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            return;
+        }
+        
+        switch (subChoice) {
+            case 1: {
+                Date date = readDate("Enter date (day month year): ");
+                cout << "Balance at end of " << date << ": " << fixed << setprecision(2) << manager.balanceOn(date, balance) << endl;
+                break;
+            }
+            case 2: {
+                cout << "Category (0 = Income, 1-8 as in expenditure): ";
+                int catChoice;
+                while (!(cin >> catChoice) || catChoice < 0 || catChoice >= CATEGORY_COUNT) {
+                    cin.clear();
+                    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                    cout << "Invalid choice. Please enter a number between 0 and 8: ";
+                }
+                Date from = readDate("From (day month year): ");
+                Date to = readDate("To (day month year): ");
+                Category category = static_cast<Category>(catChoice);
+                cout << categoryToString(category) << " total from " << from << " to " << to << ": "
+                     << fixed << setprecision(2) << manager.categoryTotalBetween(category, from, to) << endl;
+                break;
+            }
+            case 3: {
+                Date from = readDate("From (day month year): ");
+                Date to = readDate("To (day month year): ");
+                cout << "Net flow from " << from << " to " << to << ": " << fixed << setprecision(2)
+                     << manager.netFlowBetween(from, to) << endl;
+                break;
+            }
+        }
+    }
+    
+    // Reads a transaction id after listing the latest ones; -1 if unknown
+    long readTransactionSlot() {
+        manager.displayRecent(10);
+        cout << "Enter transaction ID (e.g. TXN3): ";
+        string id;
+        cin >> id;
+        long slot = manager.slotForId(id);
+        if (slot < 0 || !manager.transactions.at(slot)) {
+            cout << "No transaction with that ID.\n";
+            return -1;
+        }
+        return slot;
+    }
+    
+    void editTransaction() {
+        long slot = readTransactionSlot();
+        if (slot < 0) return;
+        Transaction* current = manager.transactions.at(slot);
+        
+        double amt;
+        cout << "New amount (0 to keep " << fixed << setprecision(2) << current->getAmount() << "): ";
+        while (!(cin >> amt) || amt < 0) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid amount. Please enter a positive number or 0: ";
+        }
+        if (amt == 0) amt = current->getAmount();
+        
+        string desc;
+        cout << "New description (Enter to keep \"" << current->getDescription() << "\"): ";
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        getline(cin, desc);
+        if (desc.empty()) desc = current->getDescription();
+        
+        Date date = readDate("New date (day month year): ");
+        
+        Transaction* updated;
+        if (current->signedAmount() >= 0) {
+            updated = new Income(amt, desc, date, current->getCategory());
+        } else {
+            updated = new Expenditure(amt, desc, date, current->getCategory());
+        }
+        updated->setCurrency(current->getCurrency());
+        manager.replaceTransaction(slot, updated, balance);
+        cout << "Transaction updated. Balance: " << fixed << setprecision(2) << balance << endl;
+    }
+    
+    void historyMenu() {
+        cout << "\n1. Edit a transaction\n";
+        cout << "2. Delete a transaction\n";
+        cout << "3. Undo\n";
+        cout << "4. Redo\n";
+        cout << "5. Save checkpoint\n";
+        cout << "6. Changes since a checkpoint\n";
+        cout << "7. Restore a checkpoint\n";
+        cout << "8. Monthly report as of a checkpoint\n";
+        cout << "Enter choice: ";
+        
+        int subChoice;
+        if (!(cin >> subChoice)) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            return;
+        }
+        
+        switch (subChoice) {
+            case 1:
+                editTransaction();
+                break;
+            case 2: {
+                long slot = readTransactionSlot();
+                if (slot >= 0 && manager.removeTransaction(slot, balance)) {
+                    cout << "Transaction deleted. Balance: " << fixed << setprecision(2) << balance << endl;
+                }
+                break;
+            }
+            case 3:
+                if (manager.undo(balance)) {
+                    cout << "Undone. Balance: " << fixed << setprecision(2) << balance << endl;
+                } else {
+                    cout << "Nothing to undo.\n";
+                }
+                break;
+            case 4:
+                if (manager.redo(balance)) {
+                    cout << "Redone. Balance: " << fixed << setprecision(2) << balance << endl;
+                } else {
+                    cout << "Nothing to redo.\n";
+                }
+                break;
+            case 5: {
+                string name;
+                cout << "Checkpoint name: ";
+                cin >> name;
+                manager.saveCheckpoint(name);
+                cout << "Checkpoint \"" << name << "\" saved (" << manager.transactions.size() << " transactions).\n";
+                break;
+            }
+            case 6:
+            case 7:
+            case 8: {
+                vector<string> checkpoints = manager.getCheckpointNames();
+                if (checkpoints.empty()) {
+                    cout << "No checkpoints saved in this session.\n";
+                    break;
+                }
+                cout << "Checkpoints:";
+                for (const auto& checkpoint : checkpoints) {
+                    cout << " " << checkpoint;
+                }
+                cout << "\nCheckpoint name: ";
+                string name;
+                cin >> name;
+                const Ledger* version = manager.findCheckpoint(name);
+                if (!version) {
+                    cout << "No checkpoint named \"" << name << "\".\n";
+                } else if (subChoice == 6) {
+                    manager.displayChanges(*version);
+                } else if (subChoice == 7) {
+                    manager.restoreCheckpoint(name, balance);
+                    cout << "Restored \"" << name << "\". Balance: " << fixed << setprecision(2) << balance << endl;
+                } else {
+                    int month, year;
+                    cout << "Enter month and year (e.g. 5 2025): ";
+                    while (!(cin >> month >> year) || month < 1 || month > 12) {
+                        cin.clear();
+                        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                        cout << "Invalid input. Please enter month (1-12) and year: ";
+                    }
+                    manager.generateMonthlyReport(month, year, *version);
+                }
+                break;
+            }
+        }
+    }
+    
+    // Amounts can be followed by a currency code once exchange rates are loaded
+    string currencyHint() const {
+        return manager.getFx().currencyCount() > 0 ? " (optionally with a currency, e.g. 20 USD)" : "";
+    }
+    
+    // Optional code typed after an amount on the same line; false (with a
+    // message, rest of the line dropped) for a currency without rates
+    bool readCurrencySuffix(CurrencyCode& currency) {
+        currency = CurrencyCode();
+        while (cin.peek() == ' ' || cin.peek() == '\t') cin.get();
+        if (!isalpha(cin.peek())) return true;
+        string name;
+        cin >> name;
+        const FxTable& fx = manager.getFx();
+        if (!CurrencyCode::parse(name, currency) || !fx.has(fx.normalize(currency))) {
+            cout << "No exchange rates for \"" << name << "\" in " << FX_FILE << ".\n";
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            return false;
+        }
+        currency = fx.normalize(currency);
+        return true;
+    }
+    
+    string currencySuffix(CurrencyCode currency) const {
+        return currency.isBase() ? "" : " " + currency.toString();
+    }
+    
+    // Rupee amounts keep their usual "Rs" label
+    string currencyLabel(CurrencyCode currency) const {
+        string code = manager.getFx().codeOf(currency);
+        return code == "INR" ? "Rs" : code;
+    }
+    
+    bool confirmDuplicate() {
+        cout << "A matching transaction was already recorded within " << manager.getDuplicateWindow()
+             << " day(s). Record anyway? (1 = yes, 0 = no): ";
+        int answer;
+        if (!(cin >> answer)) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            return false;
+        }
+        return answer == 1;
+    }
+    
+    void queryMenu() {
+        cout << "Examples: category in (Food, Transportation) and amount > 500 and date >= 2025-01-01 group by month\n"
+             << "          type = income and year = 2024 group by category\n"
+             << "          description contains 'rent' or amount >= 10000\n";
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Query: ";
+        string text;
+        getline(cin, text);
+        runQuery(text);
+    }
+    
+    bool runQuery(const string& text) {
+        Query query;
+        string error;
+        if (!FinanceManager::compileQuery(text, query, error)) {
+            cout << "Invalid query: " << error << endl;
+            return false;
+        }
+        manager.displayQuery(query, listing);
+        return true;
+    }
+    
+    void exportMenu() {
+        cout << "1. Transactions\n2. Investments\n3. Monthly aggregates\nEnter choice: ";
+        int choice;
+        if (!(cin >> choice) || choice < 1 || choice > 3) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid choice.\n";
+            return;
+        }
+        string path;
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Output file (.ndjson for JSON lines, anything else for columnar): ";
+        getline(cin, path);
+        exportTo(static_cast<ExportTable>(choice - 1), path);
+    }
+    
+    bool exportTo(ExportTable table, const string& path) {
+        auto started = chrono::steady_clock::now();
+        size_t rows = 0;
+        if (!manager.exportTable(table, path, rows)) {
+            cout << "Could not write " << path << ".\n";
+            return false;
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+        cout << "Exported " << rows << " row(s) to " << path << " in " << fixed << setprecision(1) << ms << " ms.\n";
+        return true;
+    }
+    
+    void importMenu() {
+        string path, mapping;
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "File to import (.csv or .ofx): ";
+        getline(cin, path);
+        
+        bool ofx = path.size() >= 4 && FinanceManager::toLower(path.substr(path.size() - 4)) == ".ofx";
+        ImportSpec spec;
+        if (!ofx) {
+            cout << "Column mapping (Enter for date=0,desc=1,amount=2; keys: date, desc, amount,\n"
+                 << "category, delim, order=dmy|mdy|ymd, header=0|1, sign=0|1): ";
+            getline(cin, mapping);
+            if (!mapping.empty() && !spec.parse(mapping)) {
+                cout << "Invalid column mapping.\n";
+                return;
+            }
+        }
+        
+        auto started = chrono::steady_clock::now();
+        MappedFile file(path);
+        ImportResult result = ofx ? parseOfx(file) : parseDelimited(file, spec);
+        if (!result.opened) {
+            cout << "Could not open " << path << ".\n";
+            return;
+        }
+        auto parsed = chrono::steady_clock::now();
+        size_t duplicates;
+        size_t added = manager.importRows(result.rows, balance, duplicates);
+        auto finished = chrono::steady_clock::now();
+        
+        double parseSeconds = chrono::duration<double>(parsed - started).count();
+        double totalSeconds = chrono::duration<double>(finished - started).count();
+        cout << "Imported " << added << " transaction(s), skipped " << duplicates << " duplicate(s) and "
+             << result.skipped << " unreadable line(s).\n";
+        cout << "Parse: " << fixed << setprecision(3) << parseSeconds * 1000 << " ms, total: " << totalSeconds * 1000 << " ms";
+        if (totalSeconds > 0) {
+            cout << " (" << setprecision(0) << added / totalSeconds << " rows/s)";
+        }
+        cout << endl;
+    }
+    
+    void budgetRuleMenu() {
+        manager.displayBudgetRules();
+        cout << "\n1. Add category cap (per month)\n";
+        cout << "2. Add rolling-window spend limit\n";
+        cout << "3. Add minimum balance rule\n";
+        cout << "4. Remove rule\n";
+        cout << "0. Go back\n";
+        cout << "Enter choice: ";
+        
+        int subChoice;
+        if (!(cin >> subChoice) || subChoice < 1 || subChoice > 4) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            return;
+        }
+        
+        if (subChoice == 4) {
+            size_t index;
+            cout << "Enter rule number: ";
+            if (cin >> index && index >= 1 && manager.removeBudgetRule(index - 1)) {
+                cout << "Rule removed.\n";
+            } else {
+                cin.clear();
+                cout << "No such rule.\n";
+            }
+            return;
+        }
+        
+        int category = BudgetRule::ANY_CATEGORY;
+        if (subChoice != 3) {
+            cout << "Category (1-8 as in expenditure, 0 = all expenses): ";
+            int catChoice;
+            while (!(cin >> catChoice) || catChoice < 0 || catChoice > 8) {
+                cin.clear();
+                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                cout << "Invalid choice. Please enter a number between 0 and 8: ";
+            }
+            // Expenditure menu lists categories starting after INCOME
+            category = catChoice == 0 ? BudgetRule::ANY_CATEGORY : catChoice;
+        }
+        
+        double limit;
+        cout << (subChoice == 3 ? "Minimum balance: " : "Limit: ");
+        while (!(cin >> limit) || limit < 0) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid amount. Please enter a non-negative number: ";
+        }
+        
+        int window = 0;
+        if (subChoice == 2) {
+            cout << "Window length in days: ";
+            while (!(cin >> window) || window <= 0) {
+                cin.clear();
+                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                cout << "Invalid length. Please enter a positive number: ";
+            }
+        }
+        
+        cout << "Block transactions that break it? (1 = block, 0 = only warn): ";
+        int block;
+        if (!(cin >> block)) {
+            cin.clear();
+            block = 0;
+        }
+        
+        RuleKind kind = subChoice == 1 ? RuleKind::CATEGORY_CAP : subChoice == 2 ? RuleKind::ROLLING_WINDOW : RuleKind::MIN_BALANCE;
+        BudgetRule rule(kind, block ? RuleAction::BLOCK : RuleAction::ALERT, category, limit, window);
+        manager.addBudgetRule(rule);
+        cout << "Rule added: " << FinanceManager::describeRule(rule) << endl;
+    }
+
     void makeInvestment() {
         int sub = -1;
         while (sub != 0) {
@@ -772,15 +3372,19 @@ public:
                 case 1: {
                     double amt, monthly;
                     int dur;
-                    cout << "Enter amount : ";
+                    CurrencyCode currency;
+                    cout << "Enter amount" << currencyHint() << " : ";
                     while (!(cin >> amt) || amt <= 0) {
                         cin.clear();
                         cin.ignore(numeric_limits<streamsize>::max(), '\n');
                         cout << "Invalid amount. Please enter a positive number: ";
                     }
+                    if (!readCurrencySuffix(currency)) {
+                        return;
+                    }
+                    double baseAmt = manager.toBase(currency, Date(), amt);
                     
-                    if (balance - amt < 1000) {
-                        cout << "ERROR : Min Balance=1000\n";
+                    if (manager.reportViolations(manager.checkBalance(balance - baseAmt))) {
                         system("pause");
                         return;
                     }
@@ -799,24 +3403,30 @@ public:
                         cout << "Invalid amount. Please enter a positive number: ";
                     }
                     
-                    manager.addInvestment(new SIP(amt, dur, monthly));
-                    balance -= amt;
-                    cout << "\nSIP investment of " << fixed << setprecision(2) << amt << " recorded successfully!\n";
+                    Investment* sip = new SIP(amt, dur, monthly);
+                    sip->setCurrency(currency);
+                    manager.addInvestment(sip);
+                    balance -= baseAmt;
+                    cout << "\nSIP investment of " << fixed << setprecision(2) << amt << currencySuffix(currency) << " recorded successfully!\n";
                     break;
                 }
 
                 case 2: {
                     double amt;
                     int dur;
-                    cout << "Enter amount : ";
+                    CurrencyCode currency;
+                    cout << "Enter amount" << currencyHint() << " : ";
                     while (!(cin >> amt) || amt <= 0) {
                         cin.clear();
                         cin.ignore(numeric_limits<streamsize>::max(), '\n');
                         cout << "Invalid amount. Please enter a positive number: ";
                     }
+                    if (!readCurrencySuffix(currency)) {
+                        return;
+                    }
+                    double baseAmt = manager.toBase(currency, Date(), amt);
                     
-                    if (balance - amt < 1000) {
-                        cout << "ERROR: Min Balance=1000\n";
+                    if (manager.reportViolations(manager.checkBalance(balance - baseAmt))) {
                         system("pause");
                         return;
                     }
@@ -828,9 +3438,11 @@ public:
                         cout << "Invalid duration. Please enter a positive number: ";
                     }
                     
-                    manager.addInvestment(new FD(amt, dur));
-                    balance -= amt;
-                    cout << "\nFD investment of " << fixed << setprecision(2) << amt << " recorded successfully!\n";
+                    Investment* fd = new FD(amt, dur);
+                    fd->setCurrency(currency);
+                    manager.addInvestment(fd);
+                    balance -= baseAmt;
+                    cout << "\nFD investment of " << fixed << setprecision(2) << amt << currencySuffix(currency) << " recorded successfully!\n";
                     break;
                 }
 
@@ -846,7 +3458,250 @@ public:
     }
 };
 
-int main() {
+// Bulk startup for deployments that restore many ledgers at once. Each
+// ledger gets its own FinanceManager; in parallel mode the files are read
+// with readFiles (io_uring or a thread pool) and parsed on all cores while
+// other reads are still in flight.
+struct RestoredLedger {
+    string dataFile;
+    unique_ptr<FinanceManager> manager;
+    double balance = 0.0;
+    bool loaded = false;
+};
+
+// Restores only read: old years are not archived, so nothing is written
+// while ledgers load on worker threads. Every ledger is valued with the same
+// interest and exchange rate tables, read once by the caller.
+vector<RestoredLedger> restoreLedgers(const vector<string>& dataFiles, double initialBalance, const RateTable& rates,
+                                      const FxTable& exchange, bool parallel, bool allowIoUring = true,
+                                      unsigned threads = 0, BulkReadStats* stats = nullptr) {
+    vector<RestoredLedger> ledgers(dataFiles.size());
+    for (size_t i = 0; i < dataFiles.size(); i++) {
+        ledgers[i].dataFile = dataFiles[i];
+        ledgers[i].manager.reset(new FinanceManager());
+        ledgers[i].manager->setRateTables(rates, exchange);
+        ledgers[i].manager->setArchiving(false);
+        ledgers[i].balance = initialBalance;
+    }
+    if (!parallel) {
+        for (auto& ledger : ledgers) {
+            ledger.loaded = ledger.manager->loadFromFile(ledger.dataFile, ledger.balance);
+        }
+        return ledgers;
+    }
+    BulkReadStats result = readFiles(dataFiles, [&](size_t i, const char* data, size_t size, bool ok) {
+        RestoredLedger& ledger = ledgers[i];
+        if (ok) {
+            ledger.loaded = ledger.manager->loadFromBuffer(data, size, ledger.dataFile, ledger.balance);
+        }
+    }, threads, allowIoUring);
+    if (stats) {
+        *stats = result;
+    }
+    return ledgers;
+}
+
+// Times restoring every *_finance_data.txt in a directory sequentially and
+// in bulk, first with the files in the page cache and then with them evicted
+// before each pass. An untimed pass first warms the page cache. The ledgers
+// are only read, so the directory is left as it was.
+int runRestoreBenchmark(const string& directory, unsigned threads) {
+    vector<string> dataFiles;
+    vector<string> allFiles;  // side files too, for the cold passes
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        string name = entry.path().filename().string();
+        const string suffix = "_finance_data.";
+        if (name.find(suffix) == string::npos) continue;
+        allFiles.push_back(entry.path().string());
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".txt") == 0) {
+            dataFiles.push_back(entry.path().string());
+        }
+    }
+    if (error || dataFiles.empty()) {
+        cout << "No *_finance_data.txt ledgers found in " << directory << endl;
+        return 1;
+    }
+    sort(dataFiles.begin(), dataFiles.end());
+    
+    // Rate tables in the directory, as the ledgers' users would load them
+    RateTable rates = RateTable::builtin();
+    FxTable exchange;
+    rates.loadFromFile((std::filesystem::path(directory) / User::RATES_FILE).string());
+    exchange.loadFromFile((std::filesystem::path(directory) / User::FX_FILE).string());
+    restoreLedgers(dataFiles, 2000, rates, exchange, false, false);
+    
+    struct Mode {
+        const char* name;
+        bool parallel;
+        bool ioUring;
+    };
+    const Mode modes[] = {{"sequential", false, false}, {"io_uring", true, true}, {"thread pool", true, false}};
+    cout << "Restoring " << dataFiles.size() << " ledgers ("
+         << (threads ? threads : max(1u, std::thread::hardware_concurrency())) << " worker threads)\n";
+    for (bool cold : {false, true}) {
+        cout << (cold ? "Cold page cache:\n" : "Warm page cache:\n");
+        double sequentialMs = 0.0;
+        for (const auto& mode : modes) {
+            if (cold) {
+                size_t evicted = 0;
+                for (const auto& file : allFiles) {
+                    evicted += evictFromPageCache(file) ? 1 : 0;
+                }
+                if (evicted == 0) {
+                    cout << "  (page cache eviction is not supported here)\n";
+                    return 0;
+                }
+            }
+            BulkReadStats stats;
+            auto start = chrono::steady_clock::now();
+            vector<RestoredLedger> ledgers = restoreLedgers(dataFiles, 2000, rates, exchange, mode.parallel, mode.ioUring,
+                                                           threads, &stats);
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            
+            size_t loaded = 0;
+            size_t transactionCount = 0;
+            double totalBalance = 0.0;
+            for (const auto& ledger : ledgers) {
+                loaded += ledger.loaded ? 1 : 0;
+                transactionCount += ledger.manager->transactions.size();
+                totalBalance += ledger.balance;
+            }
+            if (mode.ioUring && !stats.usedIoUring) {
+                cout << setw(14) << mode.name << ": not available, used the thread pool\n";
+                continue;
+            }
+            if (!mode.parallel) {
+                sequentialMs = ms;
+            }
+            cout << setw(14) << mode.name << ": " << fixed << setprecision(1) << ms << " ms, "
+                 << setprecision(0) << (ms > 0 ? ledgers.size() * 1000.0 / ms : 0.0) << " ledgers/s, "
+                 << loaded << " loaded, " << transactionCount << " transactions, balance total "
+                 << setprecision(2) << totalBalance;
+            if (mode.parallel && ms > 0) {
+                cout << ", " << setprecision(2) << sequentialMs / ms << "x";
+            }
+            cout << endl;
+        }
+    }
+    return 0;
+}
+
+struct CommandLine {
+    ListingOptions listing;
+    int duplicateWindowDays = 3;
+    int hotYears = FinanceManager::DEFAULT_HOT_YEARS;
+    size_t coldCacheRows = FinanceManager::DEFAULT_COLD_CACHE_ROWS;
+    string restoreBenchDir;
+    unsigned threads = 0;  // 0 = one per core
+    vector<pair<ExportTable, string>> exports;
+    vector<string> queries;
+};
+
+// A whole argument holding a non-negative integer; "abc" or "10x" is rejected
+bool parseCount(const char* text, long long& value) {
+    char* end = nullptr;
+    errno = 0;
+    value = strtoll(text, &end, 10);
+    return end != text && *end == '\0' && errno == 0 && value >= 0;
+}
+
+// Listing options: --limit N --offset N --sort date|amount|category|description --desc --page-size N
+//                  --from D/M/Y --to D/M/Y
+// Duplicate detection: --dup-window DAYS
+// Cold storage: --hot-years N (years kept in the data file), --cold-cache ROWS
+// Bulk startup benchmark: --restore-bench DIR [--threads N]
+// Export and exit: --export transactions|investments|aggregates FILE (repeatable)
+// Query and exit: --query "TEXT" (repeatable; listed with the listing options)
+bool parseCommandLine(int argc, char* argv[], CommandLine& cmd) {
+    ListingOptions& opts = cmd.listing;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--desc") {
+            opts.descending = true;
+        } else if (arg == "--sort" && hasValue) {
+            if (!parseSortKey(argv[++i], opts.sortKey)) {
+                cout << "Unknown sort key: " << argv[i] << endl;
+                return false;
+            }
+        } else if ((arg == "--from" || arg == "--to") && hasValue) {
+            int day, month, year;
+            if (sscanf(argv[++i], "%d/%d/%d", &day, &month, &year) != 3 || !Date(day, month, year).isValid()) {
+                cout << "Invalid date for " << arg << " (expected D/M/Y): " << argv[i] << endl;
+                return false;
+            }
+            (arg == "--from" ? opts.fromDay : opts.toDay) = Date(day, month, year).toDayNumber();
+        } else if (arg == "--export" && i + 2 < argc) {
+            ExportTable table;
+            if (!parseExportTable(argv[++i], table)) {
+                cout << "Unknown export table: " << argv[i] << endl;
+                return false;
+            }
+            cmd.exports.emplace_back(table, argv[++i]);
+        } else if (arg == "--query" && hasValue) {
+            cmd.queries.push_back(argv[++i]);
+        } else if (arg == "--restore-bench" && hasValue) {
+            cmd.restoreBenchDir = argv[++i];
+        } else if (arg == "--threads" && hasValue) {
+            long long value;
+            if (!parseCount(argv[++i], value) || value > numeric_limits<unsigned>::max()) {
+                cout << "Invalid value for " << arg << endl;
+                return false;
+            }
+            cmd.threads = static_cast<unsigned>(value);
+        } else if (arg == "--hot-years" && hasValue) {
+            long long value;
+            if (!parseCount(argv[++i], value) || value < 1 || value > numeric_limits<int>::max()) {
+                cout << "Invalid value for " << arg << endl;
+                return false;
+            }
+            cmd.hotYears = static_cast<int>(value);
+        } else if (arg == "--cold-cache" && hasValue) {
+            long long value;
+            if (!parseCount(argv[++i], value)) {
+                cout << "Invalid value for " << arg << endl;
+                return false;
+            }
+            cmd.coldCacheRows = static_cast<size_t>(value);
+        } else if (arg == "--dup-window" && hasValue) {
+            long long value;
+            if (!parseCount(argv[++i], value) || value > numeric_limits<int>::max()) {
+                cout << "Invalid value for " << arg << endl;
+                return false;
+            }
+            cmd.duplicateWindowDays = static_cast<int>(value);
+        } else if ((arg == "--limit" || arg == "--offset" || arg == "--page-size") && hasValue) {
+            long long value;
+            if (!parseCount(argv[++i], value)) {
+                cout << "Invalid value for " << arg << endl;
+                return false;
+            }
+            if (arg == "--limit") opts.limit = static_cast<size_t>(value);
+            else if (arg == "--offset") opts.offset = static_cast<size_t>(value);
+            else opts.pageSize = static_cast<size_t>(value);
+        } else {
+            cout << "Unknown option: " << arg << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    CommandLine cmd;
+    if (!parseCommandLine(argc, argv, cmd)) {
+        cout << "Usage: " << argv[0] << " [--limit N] [--offset N] [--sort date|amount|category|description] [--desc] [--page-size N]"
+             << " [--from D/M/Y] [--to D/M/Y] [--dup-window DAYS] [--hot-years N] [--cold-cache ROWS]"
+             << " [--restore-bench DIR [--threads N]] [--export transactions|investments|aggregates FILE]"
+             << " [--query TEXT]\n";
+        return 1;
+    }
+    
+    if (!cmd.restoreBenchDir.empty()) {
+        return runRestoreBenchmark(cmd.restoreBenchDir, cmd.threads);
+    }
+    
     cout << "---Welcome to Finance Management System!!---\n\n";
     
     string username;
@@ -857,7 +3712,24 @@ int main() {
         username = "default";
     }
     
-    User user(2000, username); // Create user with initial balance 2000
+    // Exports and queries only read the ledger
+    User user(2000, username, cmd.hotYears, !cmd.exports.empty() || !cmd.queries.empty()); // Create user with initial balance 2000
+    if (user.refused) {
+        return 1;
+    }
+    user.listing = cmd.listing;
+    user.manager.setColdCacheRows(cmd.coldCacheRows);
+    user.manager.setDuplicateWindow(cmd.duplicateWindowDays);
+    if (!cmd.exports.empty() || !cmd.queries.empty()) {
+        bool ok = true;
+        for (const auto& request : cmd.exports) {
+            ok = user.exportTo(request.first, request.second) && ok;
+        }
+        for (const auto& text : cmd.queries) {
+            ok = user.runQuery(text) && ok;
+        }
+        return ok ? 0 : 1;
+    }
     user.operations();
 
     return 0;
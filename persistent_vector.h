@@ -0,0 +1,221 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Immutable vector with structural sharing: a 32-way radix trie whose nodes
+// are never modified once built. pushBack and set copy only the path from
+// the root to one leaf (O(log32 n) nodes) and share everything else with
+// the version they were made from, so keeping many versions costs little
+// more than the records that actually changed.
+template <typename T>
+class PersistentVector {
+private:
+    static constexpr int BITS = 5;
+    static constexpr size_t WIDTH = size_t(1) << BITS;
+    static constexpr size_t MASK = WIDTH - 1;
+
+    struct Node {
+        std::vector<std::shared_ptr<const Node>> children;  // inner nodes
+        std::vector<T> values;                              // leaves
+    };
+    typedef std::shared_ptr<const Node> NodePtr;
+
+    NodePtr root;
+    int shift;  // BITS * (height - 1); 0 when the root is a leaf
+    size_t count;
+
+    PersistentVector(NodePtr r, int s, size_t n) : root(std::move(r)), shift(s), count(n) {}
+
+    const Node* leafFor(size_t index) const {
+        const Node* node = root.get();
+        for (int level = shift; level > 0; level -= BITS) {
+            node = node->children[(index >> level) & MASK].get();
+        }
+        return node;
+    }
+
+    // Copy of the path to index with the value stored; the node may be null
+    // (or short) when index is one past the end
+    static NodePtr assign(const Node* node, int level, size_t index, const T& value) {
+        auto copy = node ? std::make_shared<Node>(*node) : std::make_shared<Node>();
+        size_t slot = (index >> level) & MASK;
+        if (level == 0) {
+            if (slot == copy->values.size()) copy->values.push_back(value);
+            else copy->values[slot] = value;
+        } else {
+            const Node* child = slot < copy->children.size() ? copy->children[slot].get() : nullptr;
+            NodePtr updated = assign(child, level - BITS, index, value);
+            if (slot == copy->children.size()) copy->children.push_back(updated);
+            else copy->children[slot] = updated;
+        }
+        return copy;
+    }
+
+    template <typename F>
+    static void visit(const Node* node, int level, size_t offset, F& fn) {
+        if (level == 0) {
+            for (size_t i = 0; i < node->values.size(); i++) fn(offset + i, node->values[i]);
+            return;
+        }
+        for (size_t c = 0; c < node->children.size(); c++) {
+            visit(node->children[c].get(), level - BITS, offset + (c << level), fn);
+        }
+    }
+
+    // Child c of a node that is drawn at `level` but really lives at nodeLevel;
+    // a shorter tree is the leftmost child of an imaginary taller root
+    static const Node* childOf(const Node* node, int nodeLevel, int level, size_t c, int& childLevel) {
+        if (!node) return nullptr;
+        if (nodeLevel < level) {
+            childLevel = nodeLevel;
+            return c == 0 ? node : nullptr;
+        }
+        childLevel = nodeLevel - BITS;
+        return c < node->children.size() ? node->children[c].get() : nullptr;
+    }
+
+    template <typename F>
+    static void diffNodes(const Node* a, int aLevel, const Node* b, int bLevel, int level, size_t offset, F& fn) {
+        if (a == b && aLevel == bLevel) return;  // shared subtree
+        if (level == 0) {
+            size_t na = a ? a->values.size() : 0;
+            size_t nb = b ? b->values.size() : 0;
+            for (size_t i = 0; i < std::max(na, nb); i++) {
+                const T* before = i < na ? &a->values[i] : nullptr;
+                const T* after = i < nb ? &b->values[i] : nullptr;
+                if (!before || !after || !(*before == *after)) fn(offset + i, before, after);
+            }
+            return;
+        }
+        size_t na = a ? (aLevel < level ? 1 : a->children.size()) : 0;
+        size_t nb = b ? (bLevel < level ? 1 : b->children.size()) : 0;
+        for (size_t c = 0; c < std::max(na, nb); c++) {
+            int ca = 0, cb = 0;
+            const Node* childA = childOf(a, aLevel, level, c, ca);
+            const Node* childB = childOf(b, bLevel, level, c, cb);
+            diffNodes(childA, ca, childB, cb, level - BITS, offset + (c << level), fn);
+        }
+    }
+
+public:
+    PersistentVector() : shift(0), count(0) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    const T& operator[](size_t index) const {
+        return leafFor(index)->values[index & MASK];
+    }
+
+    // True if both are the same version (or share the whole trie)
+    bool sameAs(const PersistentVector& other) const {
+        return root == other.root && count == other.count;
+    }
+
+    PersistentVector pushBack(const T& value) const {
+        if (!root) {
+            auto leaf = std::make_shared<Node>();
+            leaf->values.push_back(value);
+            return PersistentVector(leaf, 0, 1);
+        }
+        // Full trie: grow a level with the old root as the first child
+        if (count == (size_t(1) << (shift + BITS))) {
+            auto top = std::make_shared<Node>();
+            top->children.push_back(root);
+            int grown = shift + BITS;
+            return PersistentVector(assign(top.get(), grown, count, value), grown, count + 1);
+        }
+        return PersistentVector(assign(root.get(), shift, count, value), shift, count + 1);
+    }
+
+    PersistentVector set(size_t index, const T& value) const {
+        return PersistentVector(assign(root.get(), shift, index, value), shift, count);
+    }
+
+    // fn(index, value) for every element in order
+    template <typename F>
+    void forEach(F fn) const {
+        if (root) visit(root.get(), shift, 0, fn);
+    }
+
+    // fn(index, before, after) for every index whose value differs between
+    // this version and other, in index order. A side that has no element at
+    // the index passes nullptr. Subtrees the two versions share are skipped,
+    // so comparing nearby versions costs O(changes * log n), not O(n).
+    template <typename F>
+    void diff(const PersistentVector& other, F fn) const {
+        int level = std::max(shift, other.shift);
+        diffNodes(root.get(), shift, other.root.get(), other.shift, level, 0, fn);
+    }
+};
+
+// Undo/redo stacks and named checkpoints over immutable versions. Every
+// entry is a whole version, which is cheap because versions share structure.
+template <typename V>
+class VersionHistory {
+private:
+    std::vector<V> undoStack;
+    std::vector<V> redoStack;
+    std::vector<std::pair<std::string, V>> checkpoints;
+    size_t limit;
+
+public:
+    explicit VersionHistory(size_t maxUndo = 256) : limit(maxUndo) {}
+
+    // Call with the version about to be replaced by a new edit
+    void record(const V& current) {
+        undoStack.push_back(current);
+        if (undoStack.size() > limit) undoStack.erase(undoStack.begin());
+        redoStack.clear();
+    }
+
+    bool canUndo() const { return !undoStack.empty(); }
+    bool canRedo() const { return !redoStack.empty(); }
+
+    // Returns the version to go back to; current goes on the redo stack
+    V undo(const V& current) {
+        V previous = undoStack.back();
+        undoStack.pop_back();
+        redoStack.push_back(current);
+        return previous;
+    }
+
+    V redo(const V& current) {
+        V next = redoStack.back();
+        redoStack.pop_back();
+        undoStack.push_back(current);
+        return next;
+    }
+
+    // Saving under an existing name replaces that checkpoint
+    void checkpoint(const std::string& name, const V& version) {
+        for (auto& entry : checkpoints) {
+            if (entry.first == name) {
+                entry.second = version;
+                return;
+            }
+        }
+        checkpoints.emplace_back(name, version);
+    }
+
+    const V* find(const std::string& name) const {
+        for (const auto& entry : checkpoints) {
+            if (entry.first == name) return &entry.second;
+        }
+        return nullptr;
+    }
+
+    const std::vector<std::pair<std::string, V>>& getCheckpoints() const {
+        return checkpoints;
+    }
+
+    void clear() {
+        undoStack.clear();
+        redoStack.clear();
+        checkpoints.clear();
+    }
+};
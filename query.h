@@ -0,0 +1,793 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "date.h"
+
+// Small filter language over ledger rows, e.g.
+//   category in (Food, Transportation) and amount > 500 and date >= 2025-01-01 group by month
+// Fields: date, year, amount, category, type (income|expense), description
+// Operators: = != < <= > >=, "in (...)", and "contains" for descriptions;
+// conditions combine with and, or, not and parentheses. A query is parsed
+// once into a tree of filters that each narrow a selection of row numbers
+// over a batch of columns, then the selected rows are aggregated.
+
+// Up to CAPACITY rows in column order, filled by the caller from its records
+struct RowBatch {
+    static constexpr size_t CAPACITY = 1024;
+
+    size_t size = 0;
+    int32_t day[CAPACITY];       // Date::toDayNumber()
+    int32_t month[CAPACITY];     // Date::monthIndex()
+    uint8_t category[CAPACITY];  // below QUERY_MAX_CATEGORIES
+    uint8_t income[CAPACITY];    // 1 for money coming in
+    double amount[CAPACITY];     // always positive, in the base currency once converted
+    uint16_t currency[CAPACITY];  // packed code, 0 for the base currency
+    const std::string* description[CAPACITY];
+    const void* source[CAPACITY];  // the caller's record
+
+    bool full() const { return size == CAPACITY; }
+
+    void push(const Date& date, int cat, bool in, double amt, uint16_t cur, const std::string* desc, const void* src) {
+        day[size] = date.toDayNumber();
+        month[size] = date.monthIndex();
+        category[size] = static_cast<uint8_t>(cat);
+        income[size] = in ? 1 : 0;
+        amount[size] = amt;
+        currency[size] = cur;
+        description[size] = desc;
+        source[size] = src;
+        size++;
+    }
+};
+
+static constexpr int QUERY_MAX_CATEGORIES = 16;
+
+enum class GroupKey {
+    NONE,
+    MONTH,
+    YEAR,
+    CATEGORY,
+    TYPE
+};
+
+struct QueryTotals {
+    size_t count = 0;
+    double income = 0.0;
+    double expense = 0.0;
+
+    double net() const { return income - expense; }
+};
+
+struct QueryResult {
+    GroupKey key = GroupKey::NONE;
+    QueryTotals total;
+    std::map<int64_t, QueryTotals> groups;  // month index, year, category or 1/0 for income/expense
+};
+
+// A filter narrows sel[0, n) (row numbers in increasing order) to the rows
+// it matches and returns how many are left
+class RowFilter {
+public:
+    virtual ~RowFilter() {}
+    virtual size_t apply(const RowBatch& batch, uint16_t* sel, size_t n) const = 0;
+};
+
+// Date, amount, category and type conditions of one "and" folded into
+// ranges and a bit mask. Bit income * QUERY_MAX_CATEGORIES + category is set
+// for every (type, category) pair that passes.
+struct QueryBounds {
+    int dayLo = INT_MIN;
+    int dayHi = INT_MAX;
+    double amountLo = -std::numeric_limits<double>::infinity();
+    double amountHi = std::numeric_limits<double>::infinity();
+    uint32_t mask = ~0u;
+
+    bool hasDays() const { return dayLo != INT_MIN || dayHi != INT_MAX; }
+    bool hasAmounts() const { return !std::isinf(amountLo) || !std::isinf(amountHi); }
+    bool hasMask() const { return mask != ~0u; }
+
+    static uint32_t categoryBit(int category, bool income) {
+        return 1u << ((income ? QUERY_MAX_CATEGORIES : 0) + category);
+    }
+
+    static uint32_t typeMask(bool income) {
+        uint32_t half = (1u << QUERY_MAX_CATEGORIES) - 1;
+        return income ? half << QUERY_MAX_CATEGORIES : half;
+    }
+};
+
+// The fused fast path: one pass over the selection checks every folded
+// condition, and the checks a query does not use are compiled out
+template <bool Days, bool Amounts, bool Mask>
+class BoundsFilter : public RowFilter {
+private:
+    QueryBounds bounds;
+
+public:
+    explicit BoundsFilter(const QueryBounds& b) : bounds(b) {}
+
+    size_t apply(const RowBatch& batch, uint16_t* sel, size_t n) const override {
+        const int dayLo = bounds.dayLo, dayHi = bounds.dayHi;
+        const double amountLo = bounds.amountLo, amountHi = bounds.amountHi;
+        const uint32_t mask = bounds.mask;
+        size_t out = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint16_t r = sel[i];
+            bool keep = true;
+            if (Days) keep = keep & (batch.day[r] >= dayLo) & (batch.day[r] <= dayHi);
+            if (Amounts) keep = keep & (batch.amount[r] >= amountLo) & (batch.amount[r] <= amountHi);
+            if (Mask) keep = keep & (((mask >> (batch.income[r] * QUERY_MAX_CATEGORIES + batch.category[r])) & 1u) != 0);
+            sel[out] = r;
+            out += keep;
+        }
+        return out;
+    }
+};
+
+// Case-insensitive "contains" or "=" on descriptions
+class DescriptionFilter : public RowFilter {
+private:
+    std::string needle;  // lower case
+    bool whole;
+
+    static bool sameChar(char a, char b) {
+        return std::tolower(static_cast<unsigned char>(a)) == b;
+    }
+
+public:
+    DescriptionFilter(const std::string& text, bool equals) : needle(text), whole(equals) {
+        for (char& c : needle) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+
+    size_t apply(const RowBatch& batch, uint16_t* sel, size_t n) const override {
+        size_t out = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint16_t r = sel[i];
+            const std::string& d = *batch.description[r];
+            bool keep = whole ? d.size() == needle.size() && std::equal(d.begin(), d.end(), needle.begin(), sameChar)
+                              : std::search(d.begin(), d.end(), needle.begin(), needle.end(), sameChar) != d.end();
+            sel[out] = r;
+            out += keep;
+        }
+        return out;
+    }
+};
+
+class AndFilter : public RowFilter {
+private:
+    std::vector<std::unique_ptr<RowFilter>> parts;
+
+public:
+    explicit AndFilter(std::vector<std::unique_ptr<RowFilter>> p) : parts(std::move(p)) {}
+
+    size_t apply(const RowBatch& batch, uint16_t* sel, size_t n) const override {
+        for (size_t i = 0; i < parts.size() && n > 0; i++) {
+            n = parts[i]->apply(batch, sel, n);
+        }
+        return n;
+    }
+};
+
+// Each alternative only sees the rows no earlier one has matched
+class OrFilter : public RowFilter {
+private:
+    std::vector<std::unique_ptr<RowFilter>> parts;
+
+public:
+    explicit OrFilter(std::vector<std::unique_ptr<RowFilter>> p) : parts(std::move(p)) {}
+
+    size_t apply(const RowBatch& batch, uint16_t* sel, size_t n) const override {
+        uint16_t pending[RowBatch::CAPACITY];
+        uint16_t hits[RowBatch::CAPACITY];
+        uint8_t matched[RowBatch::CAPACITY];
+        for (size_t i = 0; i < n; i++) matched[sel[i]] = 0;
+        std::copy(sel, sel + n, pending);
+        size_t left = n;
+        for (size_t p = 0; p < parts.size() && left > 0; p++) {
+            std::copy(pending, pending + left, hits);
+            size_t found = parts[p]->apply(batch, hits, left);
+            for (size_t i = 0; i < found; i++) matched[hits[i]] = 1;
+            size_t keep = 0;
+            for (size_t i = 0; i < left; i++) {
+                pending[keep] = pending[i];
+                keep += matched[pending[i]] ^ 1;
+            }
+            left = keep;
+        }
+        size_t out = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint16_t r = sel[i];
+            sel[out] = r;
+            out += matched[r];
+        }
+        return out;
+    }
+};
+
+class NotFilter : public RowFilter {
+private:
+    std::unique_ptr<RowFilter> inner;
+
+public:
+    explicit NotFilter(std::unique_ptr<RowFilter> f) : inner(std::move(f)) {}
+
+    size_t apply(const RowBatch& batch, uint16_t* sel, size_t n) const override {
+        uint16_t hits[RowBatch::CAPACITY];
+        uint8_t matched[RowBatch::CAPACITY];
+        for (size_t i = 0; i < n; i++) matched[sel[i]] = 0;
+        std::copy(sel, sel + n, hits);
+        size_t found = inner->apply(batch, hits, n);
+        for (size_t i = 0; i < found; i++) matched[hits[i]] = 1;
+        size_t out = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint16_t r = sel[i];
+            sel[out] = r;
+            out += matched[r] ^ 1;
+        }
+        return out;
+    }
+};
+
+// Adds the selected rows to the overall totals and to their group
+class QueryAggregator {
+public:
+    virtual ~QueryAggregator() {}
+    virtual void add(const RowBatch& batch, const uint16_t* sel, size_t n, QueryResult& result) const = 0;
+};
+
+struct MonthKey {
+    static int64_t of(const RowBatch& b, size_t r) { return b.month[r]; }
+};
+
+struct YearKey {
+    static int64_t of(const RowBatch& b, size_t r) { return b.month[r] / 12; }
+};
+
+struct CategoryKey {
+    static int64_t of(const RowBatch& b, size_t r) { return b.category[r]; }
+};
+
+struct TypeKey {
+    static int64_t of(const RowBatch& b, size_t r) { return b.income[r]; }
+};
+
+inline void addRow(QueryTotals& totals, const RowBatch& b, size_t r) {
+    totals.count++;
+    (b.income[r] ? totals.income : totals.expense) += b.amount[r];
+}
+
+class TotalAggregator : public QueryAggregator {
+public:
+    void add(const RowBatch& batch, const uint16_t* sel, size_t n, QueryResult& result) const override {
+        for (size_t i = 0; i < n; i++) addRow(result.total, batch, sel[i]);
+    }
+};
+
+// Rows arrive mostly in date order, so consecutive rows usually share a
+// group and the map lookup is skipped
+template <typename Key>
+class GroupAggregator : public QueryAggregator {
+public:
+    void add(const RowBatch& batch, const uint16_t* sel, size_t n, QueryResult& result) const override {
+        QueryTotals* group = nullptr;
+        int64_t last = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint16_t r = sel[i];
+            int64_t key = Key::of(batch, r);
+            if (!group || key != last) {
+                group = &result.groups[key];
+                last = key;
+            }
+            addRow(*group, batch, r);
+            addRow(result.total, batch, r);
+        }
+    }
+};
+
+namespace query_detail {
+
+enum class Field { DATE, YEAR, AMOUNT, CATEGORY, TYPE, DESCRIPTION };
+enum class Op { EQ, NE, LT, LE, GT, GE, IN, CONTAINS };
+
+struct Node {
+    enum Kind { AND, OR, NOT, COMPARE } kind;
+    Field field = Field::DATE;
+    Op op = Op::EQ;
+    std::vector<double> values;  // days, years, amounts, category ids or 1/0 for the type
+    std::string text;            // description
+    std::vector<std::unique_ptr<Node>> children;
+
+    explicit Node(Kind k) : kind(k) {}
+};
+
+inline std::string lower(std::string s) {
+    for (char& c : s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return s;
+}
+
+// YYYY-MM-DD or D/M/Y
+inline bool parseDateLiteral(const std::string& s, Date& date) {
+    int a, b, c;
+    char extra;
+    if (std::sscanf(s.c_str(), "%d-%d-%d%c", &a, &b, &c, &extra) == 3) date = Date(c, b, a);
+    else if (std::sscanf(s.c_str(), "%d/%d/%d%c", &a, &b, &c, &extra) == 3) date = Date(a, b, c);
+    else return false;
+    return date.isValid();
+}
+
+class Parser {
+private:
+    std::vector<std::string> tokens;
+    size_t pos;
+    const std::function<int(const std::string&)>& categoryOf;
+    std::string error;
+
+    bool fail(const std::string& message) {
+        if (error.empty()) error = message;
+        return false;
+    }
+
+    const std::string& peek() const {
+        static const std::string end;
+        return pos < tokens.size() ? tokens[pos] : end;
+    }
+
+    bool peekWord(const char* word) const {
+        return lower(peek()) == word;
+    }
+
+    bool accept(const char* word) {
+        if (!peekWord(word)) return false;
+        pos++;
+        return true;
+    }
+
+    void tokenize(const std::string& text) {
+        static const std::string single = "(),";
+        size_t i = 0;
+        while (i < text.size()) {
+            char c = text[i];
+            if (std::isspace(static_cast<unsigned char>(c))) {
+                i++;
+            } else if (c == '\'' || c == '"') {
+                size_t close = text.find(c, i + 1);
+                if (close == std::string::npos) close = text.size();
+                tokens.push_back(text.substr(i, close - i));  // keeps the opening quote as a marker
+                i = close + 1;
+            } else if (single.find(c) != std::string::npos) {
+                tokens.push_back(std::string(1, c));
+                i++;
+            } else if (c == '<' || c == '>' || c == '=' || c == '!') {
+                size_t len = i + 1 < text.size() && (text[i + 1] == '=' || (c == '<' && text[i + 1] == '>')) ? 2 : 1;
+                tokens.push_back(text.substr(i, len));
+                i += len;
+            } else {
+                size_t start = i;
+                while (i < text.size() && !std::isspace(static_cast<unsigned char>(text[i])) &&
+                       std::string("(),<>=!'\"").find(text[i]) == std::string::npos) {
+                    i++;
+                }
+                tokens.push_back(text.substr(start, i - start));
+            }
+        }
+    }
+
+    static bool isQuoted(const std::string& token) {
+        return !token.empty() && (token[0] == '\'' || token[0] == '"');
+    }
+
+    static std::string unquoted(const std::string& token) {
+        return isQuoted(token) ? token.substr(1) : token;
+    }
+
+    bool parseOp(Op& op) {
+        std::string t = lower(peek());
+        if (t == "=" || t == "==") op = Op::EQ;
+        else if (t == "!=" || t == "<>") op = Op::NE;
+        else if (t == "<") op = Op::LT;
+        else if (t == "<=") op = Op::LE;
+        else if (t == ">") op = Op::GT;
+        else if (t == ">=") op = Op::GE;
+        else if (t == "in") op = Op::IN;
+        else if (t == "contains") op = Op::CONTAINS;
+        else return fail("expected an operator after the field, found \"" + peek() + "\"");
+        pos++;
+        return true;
+    }
+
+    bool parseValue(Field field, const std::string& token, double& value) {
+        std::string text = unquoted(token);
+        switch (field) {
+            case Field::DATE: {
+                Date date;
+                if (!parseDateLiteral(text, date)) return fail("invalid date \"" + text + "\" (use YYYY-MM-DD or D/M/Y)");
+                value = date.toDayNumber();
+                return true;
+            }
+            case Field::CATEGORY: {
+                int category = categoryOf(text);
+                if (category < 0 || category >= QUERY_MAX_CATEGORIES) return fail("unknown category \"" + text + "\"");
+                value = category;
+                return true;
+            }
+            case Field::TYPE: {
+                std::string t = lower(text);
+                if (t == "income") value = 1;
+                else if (t == "expense" || t == "expenditure") value = 0;
+                else return fail("type is income or expense, not \"" + text + "\"");
+                return true;
+            }
+            default: {
+                char* end = nullptr;
+                value = std::strtod(text.c_str(), &end);
+                if (text.empty() || *end != '\0' || !std::isfinite(value)) return fail("invalid number \"" + text + "\"");
+                return true;
+            }
+        }
+    }
+
+    std::unique_ptr<Node> comparison() {
+        static const std::pair<const char*, Field> fields[] = {
+            {"date", Field::DATE}, {"year", Field::YEAR}, {"amount", Field::AMOUNT},
+            {"category", Field::CATEGORY}, {"type", Field::TYPE}, {"description", Field::DESCRIPTION}};
+        std::unique_ptr<Node> node(new Node(Node::COMPARE));
+        std::string name = lower(peek());
+        bool known = false;
+        for (const auto& f : fields) {
+            if (name == f.first) {
+                node->field = f.second;
+                known = true;
+            }
+        }
+        if (!known) {
+            fail(peek().empty() ? "expected a condition" : "unknown field \"" + peek() + "\"");
+            return nullptr;
+        }
+        pos++;
+        if (!parseOp(node->op)) return nullptr;
+        if (node->field == Field::DESCRIPTION) {
+            if (node->op != Op::EQ && node->op != Op::NE && node->op != Op::CONTAINS) {
+                fail("descriptions support =, != and contains");
+                return nullptr;
+            }
+            if (peek().empty()) {
+                fail("expected a description");
+                return nullptr;
+            }
+            node->text = unquoted(tokens[pos++]);
+            return node;
+        }
+        if (node->op == Op::CONTAINS) {
+            fail("contains only applies to description");
+            return nullptr;
+        }
+        if ((node->field == Field::CATEGORY || node->field == Field::TYPE) && node->op != Op::EQ &&
+                node->op != Op::NE && node->op != Op::IN) {
+            fail("category and type support =, != and in");
+            return nullptr;
+        }
+        if (node->op == Op::IN) {
+            if (!accept("(")) {
+                fail("expected ( after in");
+                return nullptr;
+            }
+            do {
+                double value;
+                if (peek().empty() || !parseValue(node->field, tokens[pos++], value)) {
+                    fail("expected a value in the list");
+                    return nullptr;
+                }
+                node->values.push_back(value);
+            } while (accept(","));
+            if (!accept(")")) {
+                fail("expected ) after the list");
+                return nullptr;
+            }
+            return node;
+        }
+        double value;
+        if (peek().empty() || !parseValue(node->field, tokens[pos++], value)) {
+            fail("expected a value after the operator");
+            return nullptr;
+        }
+        node->values.push_back(value);
+        return node;
+    }
+
+    std::unique_ptr<Node> factor() {
+        if (accept("not")) {
+            std::unique_ptr<Node> inner = factor();
+            if (!inner) return nullptr;
+            std::unique_ptr<Node> node(new Node(Node::NOT));
+            node->children.push_back(std::move(inner));
+            return node;
+        }
+        if (accept("(")) {
+            std::unique_ptr<Node> inner = expression();
+            if (!inner) return nullptr;
+            if (!accept(")")) {
+                fail("expected )");
+                return nullptr;
+            }
+            return inner;
+        }
+        return comparison();
+    }
+
+    std::unique_ptr<Node> sequence(Node::Kind kind, const char* word) {
+        std::unique_ptr<Node> first = kind == Node::OR ? sequence(Node::AND, "and") : factor();
+        if (!first || !peekWord(word)) return first;
+        std::unique_ptr<Node> node(new Node(kind));
+        node->children.push_back(std::move(first));
+        while (accept(word)) {
+            std::unique_ptr<Node> next = kind == Node::OR ? sequence(Node::AND, "and") : factor();
+            if (!next) return nullptr;
+            node->children.push_back(std::move(next));
+        }
+        return node;
+    }
+
+    std::unique_ptr<Node> expression() {
+        return sequence(Node::OR, "or");
+    }
+
+public:
+    Parser(const std::string& text, const std::function<int(const std::string&)>& lookup)
+        : pos(0), categoryOf(lookup) {
+        tokenize(text);
+    }
+
+    // Empty condition (null) with no error means every row
+    bool parse(std::unique_ptr<Node>& condition, GroupKey& key, std::string& message) {
+        accept("where");
+        condition.reset();
+        key = GroupKey::NONE;
+        if (!peek().empty() && !peekWord("group")) {
+            condition = expression();
+            if (!condition) {
+                message = error;
+                return false;
+            }
+        }
+        if (accept("group")) {
+            if (!accept("by")) {
+                message = "expected \"by\" after group";
+                return false;
+            }
+            std::string name = lower(peek());
+            if (name == "month") key = GroupKey::MONTH;
+            else if (name == "year") key = GroupKey::YEAR;
+            else if (name == "category") key = GroupKey::CATEGORY;
+            else if (name == "type") key = GroupKey::TYPE;
+            else {
+                message = "group by month, year, category or type";
+                return false;
+            }
+            pos++;
+        }
+        if (!peek().empty()) {
+            message = "unexpected \"" + peek() + "\"";
+            return false;
+        }
+        return true;
+    }
+};
+
+// Folds a comparison into the bounds; false if it needs a filter of its own
+inline bool absorb(const Node& node, QueryBounds& b) {
+    if (node.kind != Node::COMPARE || node.field == Field::DESCRIPTION) return false;
+    if (node.field == Field::CATEGORY || node.field == Field::TYPE) {
+        uint32_t bits = 0;
+        for (double v : node.values) {
+            int value = static_cast<int>(v);
+            bits |= node.field == Field::TYPE ? QueryBounds::typeMask(value == 1)
+                                              : QueryBounds::categoryBit(value, false) | QueryBounds::categoryBit(value, true);
+        }
+        b.mask &= node.op == Op::NE ? ~bits : bits;
+        return true;
+    }
+    if (node.op == Op::NE || node.op == Op::IN) return false;
+    double v = node.values[0];
+    if (node.field == Field::AMOUNT) {
+        const double inf = std::numeric_limits<double>::infinity();
+        switch (node.op) {
+            case Op::EQ: b.amountLo = std::max(b.amountLo, v); b.amountHi = std::min(b.amountHi, v); break;
+            case Op::LT: b.amountHi = std::min(b.amountHi, std::nextafter(v, -inf)); break;
+            case Op::LE: b.amountHi = std::min(b.amountHi, v); break;
+            case Op::GT: b.amountLo = std::max(b.amountLo, std::nextafter(v, inf)); break;
+            case Op::GE: b.amountLo = std::max(b.amountLo, v); break;
+            default: break;
+        }
+        return true;
+    }
+    // Dates and years become day ranges
+    int first, last;
+    if (node.field == Field::YEAR) {
+        int year = static_cast<int>(v);
+        first = Date(1, 1, year).toDayNumber();
+        last = Date(31, 12, year).toDayNumber();
+    } else {
+        first = last = static_cast<int>(v);
+    }
+    switch (node.op) {
+        case Op::EQ: b.dayLo = std::max(b.dayLo, first); b.dayHi = std::min(b.dayHi, last); break;
+        case Op::LT: b.dayHi = std::min(b.dayHi, first - 1); break;
+        case Op::LE: b.dayHi = std::min(b.dayHi, last); break;
+        case Op::GT: b.dayLo = std::max(b.dayLo, last + 1); break;
+        case Op::GE: b.dayLo = std::max(b.dayLo, first); break;
+        default: break;
+    }
+    return true;
+}
+
+template <bool Days, bool Amounts>
+std::unique_ptr<RowFilter> boundsWithMask(const QueryBounds& b) {
+    if (b.hasMask()) return std::unique_ptr<RowFilter>(new BoundsFilter<Days, Amounts, true>(b));
+    return std::unique_ptr<RowFilter>(new BoundsFilter<Days, Amounts, false>(b));
+}
+
+// The specialization that checks only what the bounds restrict; null if nothing
+inline std::unique_ptr<RowFilter> boundsFilter(const QueryBounds& b) {
+    if (!b.hasDays() && !b.hasAmounts() && !b.hasMask()) return nullptr;
+    if (b.hasDays()) return b.hasAmounts() ? boundsWithMask<true, true>(b) : boundsWithMask<true, false>(b);
+    return b.hasAmounts() ? boundsWithMask<false, true>(b) : boundsWithMask<false, false>(b);
+}
+
+inline std::unique_ptr<RowFilter> compile(const Node& node, QueryBounds* outer);
+
+// Conditions that fold into bounds share one fused filter, run first; the
+// rest follow in the order written. outer receives the folded bounds.
+inline std::unique_ptr<RowFilter> compileAnd(const std::vector<const Node*>& parts, QueryBounds* outer) {
+    QueryBounds b;
+    std::vector<std::unique_ptr<RowFilter>> rest;
+    for (const Node* part : parts) {
+        if (absorb(*part, b)) continue;
+        std::unique_ptr<RowFilter> filter = compile(*part, nullptr);
+        if (filter) rest.push_back(std::move(filter));
+    }
+    if (outer) *outer = b;
+    std::unique_ptr<RowFilter> fused = boundsFilter(b);
+    if (fused) rest.insert(rest.begin(), std::move(fused));
+    if (rest.empty()) return nullptr;
+    if (rest.size() == 1) return std::move(rest[0]);
+    return std::unique_ptr<RowFilter>(new AndFilter(std::move(rest)));
+}
+
+inline std::unique_ptr<RowFilter> compile(const Node& node, QueryBounds* outer) {
+    switch (node.kind) {
+        case Node::AND: {
+            std::vector<const Node*> parts;
+            for (const auto& child : node.children) parts.push_back(child.get());
+            return compileAnd(parts, outer);
+        }
+        case Node::OR: {
+            // Alternatives on category and type only collapse into one mask
+            uint32_t mask = 0;
+            bool masksOnly = true;
+            for (const auto& child : node.children) {
+                QueryBounds b;
+                if (!absorb(*child, b) || b.hasDays() || b.hasAmounts()) {
+                    masksOnly = false;
+                    break;
+                }
+                mask |= b.mask;
+            }
+            if (masksOnly) {
+                QueryBounds b;
+                b.mask = mask;
+                if (outer) *outer = b;
+                return boundsFilter(b);
+            }
+            std::vector<std::unique_ptr<RowFilter>> parts;
+            for (const auto& child : node.children) {
+                std::unique_ptr<RowFilter> part = compile(*child, nullptr);
+                if (!part) return nullptr;  // an alternative that matches everything
+                parts.push_back(std::move(part));
+            }
+            return std::unique_ptr<RowFilter>(new OrFilter(std::move(parts)));
+        }
+        case Node::NOT: {
+            std::unique_ptr<RowFilter> inner = compile(*node.children[0], nullptr);
+            if (!inner) {
+                QueryBounds none;
+                none.mask = 0;
+                return boundsFilter(none);
+            }
+            return std::unique_ptr<RowFilter>(new NotFilter(std::move(inner)));
+        }
+        default: {
+            if (node.field == Field::DESCRIPTION) {
+                std::unique_ptr<RowFilter> filter(new DescriptionFilter(node.text, node.op != Op::CONTAINS));
+                if (node.op == Op::NE) filter.reset(new NotFilter(std::move(filter)));
+                return filter;
+            }
+            QueryBounds probe;
+            if (absorb(node, probe)) return compileAnd({&node}, outer);
+            if (node.op == Op::IN) {
+                // amount in (...) or date in (...): any of the equalities
+                std::vector<std::unique_ptr<RowFilter>> parts;
+                for (double v : node.values) {
+                    Node eq(Node::COMPARE);
+                    eq.field = node.field;
+                    eq.values.push_back(v);
+                    parts.push_back(compile(eq, nullptr));
+                }
+                return std::unique_ptr<RowFilter>(new OrFilter(std::move(parts)));
+            }
+            if (node.op == Op::NE) {
+                Node eq(Node::COMPARE);
+                eq.field = node.field;
+                eq.values = node.values;
+                return std::unique_ptr<RowFilter>(new NotFilter(compile(eq, nullptr)));
+            }
+            return nullptr;
+        }
+    }
+}
+
+}  // namespace query_detail
+
+// A parsed and compiled query; compile once, run over any number of batches
+class Query {
+private:
+    std::unique_ptr<RowFilter> filter;  // null matches every row
+    std::unique_ptr<QueryAggregator> aggregator;
+    GroupKey key;
+    int firstDay;
+    int lastDay;
+
+public:
+    Query() : aggregator(new TotalAggregator()), key(GroupKey::NONE), firstDay(INT_MIN), lastDay(INT_MAX) {}
+
+    // categoryOf maps a category name to its number, or -1. On failure the
+    // query is left unchanged and error says why.
+    bool compile(const std::string& text, const std::function<int(const std::string&)>& categoryOf, std::string& error) {
+        std::unique_ptr<query_detail::Node> condition;
+        GroupKey group;
+        query_detail::Parser parser(text, categoryOf);
+        if (!parser.parse(condition, group, error)) return false;
+        QueryBounds bounds;
+        filter = condition ? query_detail::compile(*condition, &bounds) : nullptr;
+        firstDay = bounds.dayLo;
+        lastDay = bounds.dayHi;
+        key = group;
+        switch (key) {
+            case GroupKey::MONTH: aggregator.reset(new GroupAggregator<MonthKey>()); break;
+            case GroupKey::YEAR: aggregator.reset(new GroupAggregator<YearKey>()); break;
+            case GroupKey::CATEGORY: aggregator.reset(new GroupAggregator<CategoryKey>()); break;
+            case GroupKey::TYPE: aggregator.reset(new GroupAggregator<TypeKey>()); break;
+            default: aggregator.reset(new TotalAggregator()); break;
+        }
+        return true;
+    }
+
+    GroupKey groupKey() const { return key; }
+
+    // Every matching row is dated within these days, so callers can skip
+    // storage outside them
+    int fromDay() const { return firstDay; }
+    int toDay() const { return lastDay; }
+
+    // Fills sel with the matching row numbers of the batch; returns how many
+    size_t select(const RowBatch& batch, uint16_t* sel) const {
+        for (size_t i = 0; i < batch.size; i++) sel[i] = static_cast<uint16_t>(i);
+        return filter ? filter->apply(batch, sel, batch.size) : batch.size;
+    }
+
+    void aggregate(const RowBatch& batch, const uint16_t* sel, size_t n, QueryResult& result) const {
+        result.key = key;
+        aggregator->add(batch, sel, n, result);
+    }
+};
@@ -0,0 +1,142 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "date.h"
+
+// Interest rate curve for one product. Annual rates take effect from a given
+// month and stay in force until the next change. The curve caches a table of
+// cumulative compound factors per month, so the growth between any two
+// months is one division of two table entries instead of a pow() call.
+// The table is rebuilt whenever a rate is set, so lookups never write and
+// a curve can be read from several threads at once. Copies share the table
+// until one of them changes a rate.
+class RateCurve {
+private:
+    static constexpr int FIRST_MONTH = 1900 * 12;
+    static constexpr int LAST_MONTH = 2200 * 12;
+
+    std::map<int, double> steps;  // month index -> annual rate
+    int periodsPerYear;           // 12 = monthly compounding, 1 = yearly
+
+    std::shared_ptr<const std::vector<double>> factors;  // [m] = growth from FIRST_MONTH to m
+
+    double monthlyFactor(double annualRate) const {
+        if (periodsPerYear == 12) return 1.0 + annualRate / 12.0;
+        return std::pow(1.0 + annualRate / periodsPerYear, periodsPerYear / 12.0);
+    }
+
+    void buildFactors() {
+        auto table = std::make_shared<std::vector<double>>(LAST_MONTH - FIRST_MONTH + 1, 1.0);
+        std::vector<double>& built = *table;
+        auto step = steps.begin();
+        double rate = step != steps.end() ? step->second : 0.0;
+        double growth = monthlyFactor(rate);
+        for (int m = FIRST_MONTH + 1; m <= LAST_MONTH; m++) {
+            // Growth of month m-1 uses the rate in force during that month
+            auto next = steps.upper_bound(m - 1);
+            if (next != steps.begin()) {
+                double current = std::prev(next)->second;
+                if (current != rate) {
+                    rate = current;
+                    growth = monthlyFactor(rate);
+                }
+            }
+            built[m - FIRST_MONTH] = built[m - 1 - FIRST_MONTH] * growth;
+        }
+        factors = std::move(table);
+    }
+
+    static int clampMonth(int month) {
+        return std::min(std::max(month, FIRST_MONTH), LAST_MONTH);
+    }
+
+public:
+    RateCurve(double defaultRate = 0.0, int periods = 1) : periodsPerYear(periods) {
+        steps[FIRST_MONTH] = defaultRate;
+        buildFactors();
+    }
+
+    void setRate(int fromMonth, double annualRate) {
+        steps[clampMonth(fromMonth)] = annualRate;
+        buildFactors();
+    }
+
+    double rateAt(int month) const {
+        auto it = steps.upper_bound(clampMonth(month));
+        return std::prev(it)->second;
+    }
+
+    // One month's growth at the rate in force in the given month
+    double monthlyGrowthAt(int month) const {
+        return monthlyFactor(rateAt(month));
+    }
+
+    // Growth of one unit invested at the start of fromMonth until the start of toMonth
+    double growth(int fromMonth, int toMonth) const {
+        const std::vector<double>& table = *factors;
+        return table[clampMonth(toMonth) - FIRST_MONTH] / table[clampMonth(fromMonth) - FIRST_MONTH];
+    }
+};
+
+// Rate curves by product name ("SIP", "FD"), optionally loaded from a file
+// with lines "<product> <day> <month> <year> <annual rate>", e.g.
+// "FD 1 4 2025 0.0725". Lines starting with '#' are ignored. An SIP floats:
+// it grows at the rate in force in each month. An FD keeps the rate in force
+// in the month it opened, so a new line only affects deposits opened after it.
+class RateTable {
+private:
+    std::map<std::string, RateCurve> curves;
+
+public:
+    RateTable() {
+        curves.emplace("SIP", RateCurve(0.096, 12));
+        curves.emplace("FD", RateCurve(0.071, 1));
+    }
+
+    // Built-in rates, used by investments not attached to a loaded table
+    static const RateTable& builtin() {
+        static const RateTable table;
+        return table;
+    }
+
+    const RateCurve& curve(const std::string& product) const {
+        auto it = curves.find(product);
+        return it != curves.end() ? it->second : curves.at("FD");
+    }
+
+    void setRate(const std::string& product, const Date& from, double annualRate) {
+        auto it = curves.find(product);
+        if (it == curves.end()) {
+            it = curves.emplace(product, RateCurve(annualRate, 1)).first;
+        }
+        it->second.setRate(from.monthIndex(), annualRate);
+    }
+
+    // Returns the number of rates read, or -1 if the file could not be opened
+    int loadFromFile(const std::string& filename) {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            return -1;
+        }
+        int loaded = 0;
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            std::istringstream fields(line);
+            std::string product;
+            int day, month, year;
+            double rate;
+            if (fields >> product >> day >> month >> year >> rate) {
+                setRate(product, Date(day, month, year), rate);
+                loaded++;
+            }
+        }
+        return loaded;
+    }
+};
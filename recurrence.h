@@ -0,0 +1,99 @@
+#pragma once
+#include <algorithm>
+#include <string>
+#include "date.h"
+
+// Recurring transaction (rent, salary, ...). Only the rule is stored; its
+// occurrences are computed on demand, so storage does not grow with the
+// horizon. postedThrough is a watermark: every occurrence on or before it has
+// already been turned into a transaction, which keeps posting idempotent.
+enum class RecurrenceKind {
+    WEEKLY,
+    MONTHLY,
+    YEARLY
+};
+
+struct RecurrenceRule {
+    static const int NO_END = 2147483647;
+
+    RecurrenceKind kind;
+    int interval;       // every N weeks / months / years
+    Date anchor;        // first occurrence
+    int endDay;         // last day (day number) an occurrence may fall on
+    int dayOfMonth;     // MONTHLY/YEARLY: requested day, clamped to the month length
+    int postedThrough;  // day number of the posting watermark
+    double amount;
+    std::string description;
+    int category;
+    bool isIncome;
+    int id;  // assigned by the ledger; identifies the rule across undo steps
+
+    RecurrenceRule(RecurrenceKind k, int every, const Date& first, double amt, const std::string& desc,
+                   int cat, bool income, int end = NO_END)
+        : kind(k), interval(every > 0 ? every : 1), anchor(first), endDay(end), dayOfMonth(first.day),
+          postedThrough(first.toDayNumber() - 1), amount(amt), description(desc), category(cat), isIncome(income), id(0) {}
+
+    // Day number of the n-th occurrence (n >= 0)
+    int occurrenceDay(long long n) const {
+        if (kind == RecurrenceKind::WEEKLY) {
+            return anchor.toDayNumber() + static_cast<int>(n * 7 * interval);
+        }
+        long long months = kind == RecurrenceKind::MONTHLY ? n * interval : n * interval * 12;
+        long long index = anchor.monthIndex() + months;
+        int year = static_cast<int>(index / 12);
+        int month = static_cast<int>(index % 12) + 1;
+        return Date(std::min(dayOfMonth, Date::daysInMonth(month, year)), month, year).toDayNumber();
+    }
+
+    // Index of the first occurrence falling on or after the given day
+    long long firstIndexFrom(int day) const {
+        int first = anchor.toDayNumber();
+        if (day <= first) return 0;
+        long long n;
+        if (kind == RecurrenceKind::WEEKLY) {
+            long long step = 7LL * interval;
+            n = (day - first + step - 1) / step;
+        } else {
+            long long stepMonths = kind == RecurrenceKind::MONTHLY ? interval : 12LL * interval;
+            n = (Date::fromDayNumber(day).monthIndex() - anchor.monthIndex()) / stepMonths;
+        }
+        // The estimate is at most one step short
+        while (occurrenceDay(n) < day) n++;
+        return n;
+    }
+
+    // Calls fn(dayNumber) for each occurrence in [fromDay, toDay], in order
+    template <typename Fn>
+    void forEachOccurrence(int fromDay, int toDay, Fn fn) const {
+        toDay = std::min(toDay, endDay);
+        for (long long n = firstIndexFrom(fromDay); ; n++) {
+            int day = occurrenceDay(n);
+            if (day > toDay) break;
+            fn(day);
+        }
+    }
+
+    // Next occurrence that has not been posted yet, or NO_END if none is left
+    int nextUnposted() const {
+        int day = occurrenceDay(firstIndexFrom(postedThrough + 1));
+        return day <= endDay ? day : NO_END;
+    }
+
+    double signedAmount() const {
+        return isIncome ? amount : -amount;
+    }
+};
+
+inline std::string recurrenceKindToString(RecurrenceKind kind) {
+    switch (kind) {
+        case RecurrenceKind::WEEKLY: return "WEEKLY";
+        case RecurrenceKind::YEARLY: return "YEARLY";
+        default: return "MONTHLY";
+    }
+}
+
+inline RecurrenceKind stringToRecurrenceKind(const std::string& str) {
+    if (str == "WEEKLY") return RecurrenceKind::WEEKLY;
+    if (str == "YEARLY") return RecurrenceKind::YEARLY;
+    return RecurrenceKind::MONTHLY;
+}
@@ -0,0 +1,194 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Aggregates of one archived year, so reports over old years can be answered
+// without reading its rows: income and spending per month, and spending per
+// month and category.
+struct SegmentSummary {
+    int year;
+    size_t count;
+    int categories;
+    std::vector<double> income;   // [month - 1]
+    std::vector<double> expense;  // [month - 1]
+    std::vector<double> spend;    // [(month - 1) * categories + category]
+
+    SegmentSummary(int y = 0, int cats = 0)
+        : year(y), count(0), categories(cats), income(12, 0.0), expense(12, 0.0), spend(12 * cats, 0.0) {}
+
+    // Positive amounts are income, negative ones spending in the category
+    void add(int month, double signedAmount, int category) {
+        count++;
+        if (signedAmount >= 0) {
+            income[month - 1] += signedAmount;
+        } else {
+            expense[month - 1] -= signedAmount;
+            if (category >= 0 && category < categories) spend[(month - 1) * categories + category] -= signedAmount;
+        }
+    }
+
+    double net(int month) const {
+        return income[month - 1] - expense[month - 1];
+    }
+
+    double netTotal() const {
+        double total = 0.0;
+        for (int m = 1; m <= 12; m++) total += net(m);
+        return total;
+    }
+};
+
+// Summaries of every archived year, kept in one small file next to the
+// segments. Layout: "SEGIDX <years> <categories> <rates>", then one line per
+// year: "Y <year> <count>" followed by income, expense and the category
+// spending of each month. Amounts are in the base currency; <rates> is the
+// stamp of the exchange rates they were converted at.
+class SummaryIndex {
+private:
+    std::map<int, SegmentSummary> years;
+    int categories;
+    uint64_t rates;
+
+public:
+    explicit SummaryIndex(int cats) : categories(cats), rates(0) {}
+
+    uint64_t getRates() const { return rates; }
+    void setRates(uint64_t stamp) { rates = stamp; }
+
+    const std::map<int, SegmentSummary>& getYears() const { return years; }
+
+    const SegmentSummary* find(int year) const {
+        auto it = years.find(year);
+        return it != years.end() ? &it->second : nullptr;
+    }
+
+    SegmentSummary& at(int year) {
+        auto it = years.find(year);
+        if (it == years.end()) it = years.emplace(year, SegmentSummary(year, categories)).first;
+        return it->second;
+    }
+
+    void clear() {
+        years.clear();
+    }
+
+    bool saveToFile(const std::string& filename) const {
+        std::ofstream file(filename);
+        if (!file.is_open()) return false;
+        file.precision(15);
+        file << "SEGIDX " << years.size() << " " << categories << " " << rates << "\n";
+        for (const auto& entry : years) {
+            const SegmentSummary& s = entry.second;
+            file << "Y " << s.year << " " << s.count;
+            for (int m = 0; m < 12; m++) {
+                file << " " << s.income[m] << " " << s.expense[m];
+                for (int c = 0; c < categories; c++) file << " " << s.spend[m * categories + c];
+            }
+            file << "\n";
+        }
+        return static_cast<bool>(file);
+    }
+
+    bool loadFromFile(const std::string& filename) {
+        std::ifstream file(filename);
+        std::string tag;
+        size_t count;
+        int cats;
+        years.clear();
+        if (!(file >> tag >> count >> cats >> rates) || tag != "SEGIDX" || cats != categories) return false;
+        for (size_t i = 0; i < count; i++) {
+            SegmentSummary s(0, categories);
+            file >> tag >> s.year >> s.count;
+            for (int m = 0; m < 12; m++) {
+                file >> s.income[m] >> s.expense[m];
+                for (int c = 0; c < categories; c++) file >> s.spend[m * categories + c];
+            }
+            if (!file) {
+                years.clear();
+                return false;
+            }
+            years.emplace(s.year, s);
+        }
+        return true;
+    }
+};
+
+// Least-recently-used cache of segments read from disk, bounded by the total
+// number of rows resident. Segments are handed out as shared pointers, so an
+// evicted segment stays valid for whoever is still reading it.
+template <typename Segment>
+class SegmentCache {
+private:
+    struct Slot {
+        std::shared_ptr<const Segment> segment;
+        std::list<int>::iterator position;
+    };
+
+    std::function<Segment(int)> loader;
+    std::unordered_map<int, Slot> resident;
+    std::list<int> recent;  // most recently used first
+    size_t budgetRows;
+    size_t residentRows;
+    size_t loads;
+
+    void evictOver(int keep) {
+        while (residentRows > budgetRows && !recent.empty() && recent.back() != keep) {
+            auto it = resident.find(recent.back());
+            residentRows -= it->second.segment->size();
+            resident.erase(it);
+            recent.pop_back();
+        }
+    }
+
+public:
+    SegmentCache(std::function<Segment(int)> load, size_t budget)
+        : loader(std::move(load)), budgetRows(budget), residentRows(0), loads(0) {}
+
+    std::shared_ptr<const Segment> get(int key) {
+        auto it = resident.find(key);
+        if (it != resident.end()) {
+            recent.splice(recent.begin(), recent, it->second.position);
+            return it->second.segment;
+        }
+        auto segment = std::make_shared<const Segment>(loader(key));
+        loads++;
+        recent.push_front(key);
+        resident[key] = Slot{segment, recent.begin()};
+        residentRows += segment->size();
+        evictOver(key);
+        return segment;
+    }
+
+    // Drops a segment that changed on disk
+    void invalidate(int key) {
+        auto it = resident.find(key);
+        if (it == resident.end()) return;
+        residentRows -= it->second.segment->size();
+        recent.erase(it->second.position);
+        resident.erase(it);
+    }
+
+    void clear() {
+        resident.clear();
+        recent.clear();
+        residentRows = 0;
+    }
+
+    void setBudget(size_t rows) {
+        budgetRows = rows;
+        evictOver(recent.empty() ? 0 : recent.front());
+    }
+
+    size_t getBudget() const { return budgetRows; }
+    size_t residentCount() const { return resident.size(); }
+    size_t residentRowCount() const { return residentRows; }
+    size_t loadCount() const { return loads; }
+};
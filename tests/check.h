@@ -0,0 +1,24 @@
+#pragma once
+#include <cmath>
+#include <cstdio>
+
+// Minimal checks for the tests: a failing check prints where it failed and
+// the test keeps going, so one run reports every failure
+static int failedChecks = 0;
+
+#define CHECK(cond)                                                                        \
+    do {                                                                                   \
+        if (!(cond)) {                                                                     \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failedChecks++;                                                                \
+        }                                                                                  \
+    } while (0)
+
+#define CHECK_NEAR(a, b) CHECK(std::fabs((a) - (b)) < 1e-6)
+
+// Exit status for main: prints a one-line summary for the test
+inline int finish(const char* name) {
+    if (failedChecks == 0) std::printf("%s: ok\n", name);
+    else std::printf("%s: %d check(s) failed\n", name, failedChecks);
+    return failedChecks == 0 ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+#include "bank_import.h"
+#include "check.h"
+
+static bool amount(const char* text, double& value) {
+    return import_detail::parseAmount(text, text + std::strlen(text), value);
+}
+
+static void amounts() {
+    const struct {
+        const char* text;
+        double value;
+    } good[] = {
+        {"1234.50", 1234.5}, {"-1,234.50", -1234.5}, {"+12", 12}, {"(12.00)", -12},
+        {"-$5", -5}, {"$-5", -5}, {"1,00,000.00", 100000}, {"12,34,567", 1234567},
+        {"\"1,234\"", 1234}, {" 7.5 ", 7.5}, {"Rs. 250", 250}, {"\xE2\x82\xB9" "99", 99},
+        {"\xE2\x82\xAC" "1,000", 1000}, {"0", 0},
+    };
+    for (const auto& g : good) {
+        double value = -1;
+        bool ok = amount(g.text, value);
+        CHECK(ok);
+        if (ok) CHECK_NEAR(value, g.value);
+        else std::fprintf(stderr, "  rejected \"%s\"\n", g.text);
+    }
+
+    const char* bad[] = {
+        "", "-", "$", ".5", "12abc34", "1.234,56", "1.2.3", "12.", "--5", "+-5", "-(5)", "(-5)",
+        "1,2345", "12,34", "1,,234", ",123", "123,", "5$", "1e5", "0x10", "nan", "inf",
+        "1 234", "(12", "99999999999999999999999999999999999999999999999999999999999999999999999999",
+    };
+    for (const char* text : bad) {
+        double value = 0;
+        bool ok = amount(text, value);
+        CHECK(!ok);
+        if (ok) std::fprintf(stderr, "  accepted \"%s\" as %f\n", text, value);
+    }
+}
+
+static void quotedFields() {
+    const std::string csv =
+        "01/02/2025,\"Coffee, large\",\"-1,234.50\"\n"
+        "02/02/2025,Salary,2000\r\n"
+        "\n"
+        "03/02/2025,\"Rent; March\",(800)\n"
+        "04/02/2025,Bad amount,12abc\n"
+        "31/02/2025,Bad date,10\n"
+        "05/02/2025,Too few columns\n"
+        "06/02/2025,No newline at the end,1.5";
+    ImportSpec spec;
+    std::vector<ImportedRow> rows;
+    size_t skipped = 0;
+    import_detail::parseLines(csv.data(), csv.data() + csv.size(), spec, rows, skipped);
+
+    CHECK(rows.size() == 4);
+    CHECK(skipped == 3);
+    if (rows.size() != 4) return;
+    CHECK(rows[0].description == "Coffee, large");
+    CHECK_NEAR(rows[0].amount, -1234.5);
+    CHECK(rows[0].date == Date(1, 2, 2025));
+    CHECK(rows[1].description == "Salary");
+    CHECK_NEAR(rows[1].amount, 2000);
+    CHECK(rows[2].description == "Rent; March");
+    CHECK_NEAR(rows[2].amount, -800);
+    CHECK(rows[3].description == "No newline at the end");
+    CHECK(rows[3].date == Date(6, 2, 2025));
+
+    // Other delimiters, column orders and date orders
+    const std::string semicolons = "2025-03-09;12,50;\"Lunch; with team\";Food\n";
+    ImportSpec other;
+    CHECK(other.parse("delim=semicolon,date=0,amount=1,desc=2,category=3,order=ymd,header=0,sign=0"));
+    rows.clear();
+    skipped = 0;
+    import_detail::parseLines(semicolons.data(), semicolons.data() + semicolons.size(), other, rows, skipped);
+    // "12,50" is not a grouped amount, so the row is skipped
+    CHECK(rows.empty() && skipped == 1);
+    const std::string fixed = "2025-03-09;12.50;\"Lunch; with team\";Food\n";
+    rows.clear();
+    import_detail::parseLines(fixed.data(), fixed.data() + fixed.size(), other, rows, skipped);
+    CHECK(rows.size() == 1);
+    if (rows.size() == 1) {
+        CHECK(rows[0].date == Date(9, 3, 2025));
+        CHECK_NEAR(rows[0].amount, -12.5);
+        CHECK(rows[0].description == "Lunch; with team");
+        CHECK(rows[0].category == "Food");
+    }
+    CHECK(!other.parse("delim=ab"));
+    CHECK(!other.parse("date=40"));
+}
+
+int main() {
+    amounts();
+    quotedFields();
+    return finish("bank_import");
+}
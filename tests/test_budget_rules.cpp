@@ -0,0 +1,90 @@
+#include "budget_rules.h"
+#include "check.h"
+
+static const int CATEGORIES = 10;
+static const int FOOD = 2;
+static const int RENT = 3;
+
+static void monthlyCap() {
+    BudgetRuleEngine engine(CATEGORIES);
+    engine.addRule(BudgetRule(RuleKind::CATEGORY_CAP, RuleAction::BLOCK, FOOD, 100));
+    engine.recordExpense(FOOD, Date(15, 3, 2025), 80);
+
+    std::vector<RuleViolation> v = engine.evaluateExpense(FOOD, Date(20, 3, 2025), 30);
+    CHECK(v.size() == 1);
+    CHECK(v.size() == 1 && v[0].ruleIndex == 0);
+    CHECK(v.size() == 1 && v[0].projected == 110);
+    CHECK(BudgetRuleEngine::blocks(engine.getRules(), v));
+    // Evaluating does not count the expense
+    CHECK(engine.evaluateExpense(FOOD, Date(20, 3, 2025), 30).size() == 1);
+    CHECK(engine.evaluateExpense(FOOD, Date(20, 3, 2025), 20).empty());
+    // Other months and categories have their own counters
+    CHECK(engine.evaluateExpense(FOOD, Date(1, 4, 2025), 90).empty());
+    CHECK(engine.evaluateExpense(FOOD, Date(28, 2, 2025), 90).empty());
+    CHECK(engine.evaluateExpense(RENT, Date(20, 3, 2025), 500).empty());
+
+    // A backdated expense counts in its own month
+    engine.recordExpense(FOOD, Date(10, 1, 2025), 95);
+    CHECK(engine.evaluateExpense(FOOD, Date(31, 1, 2025), 10).size() == 1);
+    CHECK_NEAR(engine.usage(0, Date(5, 3, 2025)), 80);
+    engine.recordExpense(FOOD, Date(15, 3, 2025), -80);
+    CHECK_NEAR(engine.usage(0, Date(5, 3, 2025)), 0);
+}
+
+static void rollingWindow() {
+    BudgetRuleEngine engine(CATEGORIES);
+    engine.addRule(BudgetRule(RuleKind::ROLLING_WINDOW, RuleAction::ALERT, BudgetRule::ANY_CATEGORY, 50, 7));
+    engine.recordExpense(FOOD, Date(10, 1, 2025), 30);
+
+    // The window is the 7 days ending on the expense's own date
+    CHECK(engine.evaluateExpense(RENT, Date(5, 1, 2025), 40).empty());
+    CHECK(engine.evaluateExpense(RENT, Date(10, 1, 2025), 40).size() == 1);
+    CHECK(engine.evaluateExpense(RENT, Date(16, 1, 2025), 40).size() == 1);
+    CHECK(engine.evaluateExpense(RENT, Date(17, 1, 2025), 40).empty());
+    CHECK(!BudgetRuleEngine::blocks(engine.getRules(), engine.evaluateExpense(RENT, Date(12, 1, 2025), 40)));
+
+    // Backdated and future expenses land on their own days
+    engine.recordExpense(RENT, Date(4, 1, 2025), 15);
+    engine.recordExpense(FOOD, Date(1, 6, 2025), 45);
+    CHECK_NEAR(engine.usage(0, Date(10, 1, 2025)), 45);
+    CHECK_NEAR(engine.usage(0, Date(3, 1, 2025)), 0);
+    CHECK_NEAR(engine.usage(0, Date(3, 6, 2025)), 45);
+    CHECK(engine.evaluateExpense(FOOD, Date(10, 1, 2025), 10).size() == 1);
+    CHECK(engine.evaluateExpense(FOOD, Date(5, 1, 2025), 10).empty());
+    CHECK(engine.evaluateExpense(FOOD, Date(4, 6, 2025), 10).size() == 1);
+    CHECK(engine.evaluateExpense(FOOD, Date(8, 6, 2025), 10).empty());
+
+    // Taking an expense back out empties its day
+    engine.recordExpense(FOOD, Date(10, 1, 2025), -30);
+    CHECK_NEAR(engine.usage(0, Date(10, 1, 2025)), 15);
+    engine.clearCounters();
+    CHECK_NEAR(engine.usage(0, Date(10, 1, 2025)), 0);
+    CHECK(engine.getRules().size() == 1);
+}
+
+static void balanceRules() {
+    BudgetRuleEngine engine(CATEGORIES);
+    engine.addRule(BudgetRule(RuleKind::CATEGORY_CAP, RuleAction::ALERT, FOOD, 100));
+    engine.addRule(BudgetRule(RuleKind::MIN_BALANCE, RuleAction::BLOCK, BudgetRule::ANY_CATEGORY, 1000));
+    std::vector<RuleViolation> v;
+    engine.evaluateBalance(1500, v);
+    CHECK(v.empty());
+    engine.evaluateBalance(999, v);
+    CHECK(v.size() == 1 && v[0].ruleIndex == 1);
+    CHECK(BudgetRuleEngine::blocks(engine.getRules(), v));
+    // Balance rules are not spend rules
+    CHECK(engine.evaluateExpense(FOOD, Date(1, 1, 2025), 50).empty());
+
+    CHECK(engine.removeRule(0));
+    CHECK(!engine.removeRule(5));
+    v.clear();
+    engine.evaluateBalance(999, v);
+    CHECK(v.size() == 1 && v[0].ruleIndex == 0);
+}
+
+int main() {
+    monthlyCap();
+    rollingWindow();
+    balanceRules();
+    return finish("budget_rules");
+}
@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <random>
+#include <utility>
+#include "check.h"
+#include "date_store.h"
+
+typedef std::pair<int, int> Record;  // day, insertion number (the stored value)
+
+static std::vector<Record> scan(const DateChunkStore<int>& store, int from, int to) {
+    std::vector<Record> out;
+    store.forEachInRange(from, to, [&](int day, int value) { out.push_back(Record(day, value)); });
+    return out;
+}
+
+// What a scan should return: records in the range by day, equal days in
+// insertion order
+static std::vector<Record> naiveScan(const std::vector<Record>& records, int from, int to) {
+    std::vector<Record> out;
+    for (const Record& r : records) {
+        if (r.first >= from && r.first <= to) out.push_back(r);
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+static void appendsAndSplits() {
+    DateChunkStore<int> store;
+    CHECK(store.chunkCount() == 0);
+    CHECK(scan(store, 0, 100).empty());
+    std::vector<Record> records;
+    for (int i = 0; i < static_cast<int>(DateChunkStore<int>::CHUNK_SIZE); i++) {
+        store.insert(i, i);
+        records.push_back(Record(i, i));
+    }
+    CHECK(store.chunkCount() == 1);
+    // A full chunk splits in half
+    store.insert(1000, 1000);
+    records.push_back(Record(1000, 1000));
+    CHECK(store.chunkCount() == 2);
+    CHECK(store.size() == records.size());
+    CHECK(scan(store, 0, 2000) == naiveScan(records, 0, 2000));
+}
+
+static void randomInserts() {
+    std::mt19937 rng(35);
+    DateChunkStore<int> store;
+    std::vector<Record> records;
+    for (int i = 0; i < 5000; i++) {
+        // Mostly appends, with backdated days and runs of the same day
+        int day = i % 3 == 0 ? static_cast<int>(rng() % 3000) : i % 5 == 0 ? 1500 : 3000 + i;
+        store.insert(day, i);
+        records.push_back(Record(day, i));
+    }
+    CHECK(store.size() == records.size());
+    CHECK(store.chunkCount() >= records.size() / DateChunkStore<int>::CHUNK_SIZE);
+    CHECK(scan(store, -1, 100000) == naiveScan(records, -1, 100000));
+    for (int q = 0; q < 300; q++) {
+        int from = static_cast<int>(rng() % 9000) - 100;
+        int to = from + static_cast<int>(rng() % 2000);
+        CHECK(scan(store, from, to) == naiveScan(records, from, to));
+    }
+    CHECK(scan(store, 1500, 1500) == naiveScan(records, 1500, 1500));
+    CHECK(scan(store, 20000, 30000).empty());
+    CHECK(scan(store, 10, 5).empty());
+
+    // Erase one record of a day shared by many, and whole chunks' worth
+    CHECK(store.erase(1500, 5));
+    CHECK(!store.erase(1500, 5));
+    CHECK(!store.erase(1501, 5));
+    records.erase(std::find(records.begin(), records.end(), Record(1500, 5)));
+    std::shuffle(records.begin(), records.end(), rng);
+    for (size_t i = 0; i < 3000; i++) CHECK(store.erase(records[i].first, records[i].second));
+    records.erase(records.begin(), records.begin() + 3000);
+    CHECK(store.size() == records.size());
+    for (int q = 0; q < 100; q++) {
+        int from = static_cast<int>(rng() % 9000);
+        CHECK(scan(store, from, from + 500) == naiveScan(records, from, from + 500));
+    }
+    store.clear();
+    CHECK(store.size() == 0 && store.chunkCount() == 0);
+}
+
+int main() {
+    appendsAndSplits();
+    randomInserts();
+    return finish("date_store");
+}
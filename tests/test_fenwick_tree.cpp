@@ -0,0 +1,89 @@
+#include <climits>
+#include <random>
+#include "check.h"
+#include "fenwick_tree.h"
+
+struct Entry {
+    int day;
+    int category;
+    double amount;
+};
+
+static double naiveSum(const std::vector<Entry>& entries, int category, int from, int to) {
+    double sum = 0.0;
+    for (const Entry& e : entries) {
+        if (e.day >= from && e.day <= to && (category < 0 || e.category == category)) sum += e.amount;
+    }
+    return sum;
+}
+
+static void fenwickTree() {
+    std::vector<int> values = {5, -2, 7, 0, 3, 9, -4};
+    FenwickTree<int> built(values);
+    FenwickTree<int> added(values.size());
+    for (size_t i = 0; i < values.size(); i++) added.add(i, values[i]);
+    for (size_t from = 0; from < values.size(); from++) {
+        for (size_t to = from; to < values.size(); to++) {
+            int sum = 0;
+            for (size_t i = from; i <= to; i++) sum += values[i];
+            CHECK(built.range(from, to) == sum);
+            CHECK(added.range(from, to) == sum);
+        }
+    }
+    CHECK(built.points() == values);
+}
+
+// Random dates in any order, so the window grows both ways and backdated
+// amounts land before days already indexed
+static void dateRanges() {
+    const int CATEGORIES = 4;
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> dayOf(Date(1, 1, 1975).toDayNumber(), Date(31, 12, 2095).toDayNumber());
+    std::uniform_int_distribution<int> categoryOf(-1, CATEGORIES - 1);
+    std::uniform_int_distribution<int> centsOf(-50000, 50000);
+
+    DateSumIndex index(CATEGORIES);
+    std::vector<Entry> entries;
+    int start = Date(1, 6, 2025).toDayNumber();
+    for (int i = 0; i < 2000; i++) {
+        // Mostly near the start of the ledger, sometimes decades away
+        int day = i % 10 == 0 ? dayOf(rng) : start + static_cast<int>(rng() % 900) - 450;
+        Entry e{day, categoryOf(rng), centsOf(rng) / 100.0};
+        index.add(Date::fromDayNumber(e.day), e.category, e.amount);
+        entries.push_back(e);
+        if (i % 7 == 0) {
+            // Backdated edit: take an earlier entry back out
+            Entry& old = entries[rng() % entries.size()];
+            index.add(Date::fromDayNumber(old.day), old.category, -old.amount);
+            old.amount = 0.0;
+        }
+    }
+
+    for (int q = 0; q < 500; q++) {
+        int a = q % 2 == 0 ? dayOf(rng) : start + static_cast<int>(rng() % 1000) - 500;
+        int b = a + static_cast<int>(rng() % 4000);
+        Date from = Date::fromDayNumber(a);
+        Date to = Date::fromDayNumber(b);
+        CHECK_NEAR(index.between(from, to), naiveSum(entries, -1, a, b));
+        CHECK_NEAR(index.upTo(to), naiveSum(entries, -1, INT_MIN, b));
+        int category = static_cast<int>(rng() % CATEGORIES);
+        CHECK_NEAR(index.categoryBetween(category, from, to), naiveSum(entries, category, a, b));
+    }
+    CHECK_NEAR(index.totalAmount(), naiveSum(entries, -1, INT_MIN, INT_MAX));
+    CHECK(index.categoryBetween(CATEGORIES, Date(1, 1, 1970), Date(1, 1, 2100)) == 0.0);
+
+    // Dates outside 1970-2100 are clamped to the ends
+    index.add(Date(1, 1, 1900), 0, 10);
+    CHECK_NEAR(index.between(Date(1, 1, 1970), Date(1, 1, 1970)),
+               naiveSum(entries, -1, 0, 0) + 10);
+
+    index.clear();
+    CHECK(index.totalAmount() == 0.0);
+    CHECK(index.upTo(Date(1, 1, 2100)) == 0.0);
+}
+
+int main() {
+    fenwickTree();
+    dateRanges();
+    return finish("fenwick_tree");
+}
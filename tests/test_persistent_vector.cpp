@@ -0,0 +1,126 @@
+#include "check.h"
+#include "persistent_vector.h"
+
+typedef PersistentVector<int> Vec;
+
+static bool holds(const Vec& v, const std::vector<int>& expected) {
+    if (v.size() != expected.size()) return false;
+    for (size_t i = 0; i < expected.size(); i++) {
+        if (v[i] != expected[i]) return false;
+    }
+    size_t seen = 0;
+    bool inOrder = true;
+    v.forEach([&](size_t index, const int& value) {
+        inOrder = inOrder && index == seen && value == expected[index];
+        seen++;
+    });
+    return inOrder && seen == expected.size();
+}
+
+// Sizes around each level boundary of the 32-way trie
+static void pushBackAndSet() {
+    Vec empty;
+    CHECK(empty.empty());
+    std::vector<int> expected;
+    std::vector<Vec> versions{empty};
+    for (int i = 0; i < 33 * 32 + 5; i++) {
+        versions.push_back(versions.back().pushBack(i * 3));
+        expected.push_back(i * 3);
+    }
+    CHECK(holds(versions.back(), expected));
+    // Every earlier version still holds its own prefix
+    for (size_t n : {size_t(0), size_t(1), size_t(32), size_t(33), size_t(1024), size_t(1025)}) {
+        CHECK(holds(versions[n], std::vector<int>(expected.begin(), expected.begin() + n)));
+    }
+
+    Vec full = versions.back();
+    Vec edited = full.set(0, -1).set(500, -2).set(full.size() - 1, -3);
+    CHECK(holds(full, expected));
+    expected[0] = -1;
+    expected[500] = -2;
+    expected.back() = -3;
+    CHECK(holds(edited, expected));
+}
+
+static void versionSharing() {
+    Vec base;
+    for (int i = 0; i < 5000; i++) base = base.pushBack(i);
+    CHECK(base.sameAs(base));
+    Vec copy = base;
+    CHECK(copy.sameAs(base));
+
+    // A set copies one path and shares the rest, so a diff only visits it
+    Vec changed = base.set(1234, -1);
+    CHECK(!changed.sameAs(base));
+    std::vector<size_t> indexes;
+    base.diff(changed, [&](size_t index, const int* before, const int* after) {
+        indexes.push_back(index);
+        CHECK(before && *before == 1234);
+        CHECK(after && *after == -1);
+    });
+    CHECK(indexes == std::vector<size_t>{1234});
+
+    // Appended elements have no counterpart on the shorter side
+    Vec longer = changed.pushBack(9).pushBack(10);
+    indexes.clear();
+    base.diff(longer, [&](size_t index, const int* before, const int* after) {
+        indexes.push_back(index);
+        if (index >= base.size()) CHECK(!before && after);
+    });
+    CHECK((indexes == std::vector<size_t>{1234, 5000, 5001}));
+
+    // Versions built separately are compared value by value
+    Vec rebuilt;
+    for (int i = 0; i < 5000; i++) rebuilt = rebuilt.pushBack(i);
+    CHECK(!rebuilt.sameAs(base));
+    size_t differences = 0;
+    rebuilt.diff(base, [&](size_t, const int*, const int*) { differences++; });
+    CHECK(differences == 0);
+}
+
+static void undoRedo() {
+    VersionHistory<Vec> history(3);
+    Vec current;
+    std::vector<Vec> made{current};
+    for (int i = 0; i < 5; i++) {
+        history.record(current);
+        current = current.pushBack(i);
+        made.push_back(current);
+    }
+    CHECK(history.canUndo());
+    CHECK(!history.canRedo());
+
+    // Only the last three edits can be undone
+    current = history.undo(current);
+    CHECK(current.sameAs(made[4]));
+    current = history.undo(current);
+    current = history.undo(current);
+    CHECK(current.sameAs(made[2]));
+    CHECK(!history.canUndo());
+
+    current = history.redo(current);
+    CHECK(current.sameAs(made[3]));
+    CHECK(history.canRedo());
+
+    // A new edit drops the redo stack
+    history.record(current);
+    current = current.set(0, 42);
+    CHECK(!history.canRedo());
+    CHECK(current[0] == 42 && made[3][0] == 0);
+
+    history.checkpoint("before", made[1]);
+    history.checkpoint("now", current);
+    history.checkpoint("before", made[2]);
+    CHECK(history.getCheckpoints().size() == 2);
+    CHECK(history.find("before") && history.find("before")->sameAs(made[2]));
+    CHECK(!history.find("missing"));
+    history.clear();
+    CHECK(!history.canUndo() && history.getCheckpoints().empty());
+}
+
+int main() {
+    pushBackAndSet();
+    versionSharing();
+    undoRedo();
+    return finish("persistent_vector");
+}
@@ -0,0 +1,185 @@
+#include <functional>
+#include <random>
+#include "check.h"
+#include "query.h"
+
+static const char* const CATEGORIES[] = {"Food", "Rent", "Travel", "Salary", "Other"};
+static const char* const DESCRIPTIONS[] = {"Coffee", "Bus fare", "Groceries", "Monthly rent", "Salary", "coffee beans"};
+
+struct Row {
+    Date date;
+    int category;
+    bool income;
+    double amount;
+    std::string description;
+};
+
+static int categoryOf(const std::string& name) {
+    for (int c = 0; c < 5; c++) {
+        if (query_detail::lower(name) == query_detail::lower(CATEGORIES[c])) return c;
+    }
+    return -1;
+}
+
+static std::vector<Row> makeRows() {
+    std::mt19937 rng(39);
+    int first = Date(1, 1, 2023).toDayNumber();
+    std::vector<Row> rows;
+    for (int i = 0; i < 3000; i++) {
+        Row row;
+        row.date = Date::fromDayNumber(first + static_cast<int>(rng() % 1096));
+        row.category = static_cast<int>(rng() % 5);
+        row.income = rng() % 4 == 0;
+        row.amount = i % 50 == 0 ? 250.5 : i % 61 == 0 ? 10 : static_cast<int>(rng() % 100000) / 100.0;
+        row.description = DESCRIPTIONS[rng() % 6];
+        rows.push_back(row);
+    }
+    return rows;
+}
+
+// Runs the query over the rows in full batches plus a partial one, as the ledger does
+static std::vector<size_t> run(const Query& query, const std::vector<Row>& rows, QueryResult& result) {
+    std::vector<size_t> matched;
+    RowBatch batch;
+    uint16_t sel[RowBatch::CAPACITY];
+    size_t start = 0;
+    auto flush = [&]() {
+        size_t n = query.select(batch, sel);
+        query.aggregate(batch, sel, n, result);
+        for (size_t i = 0; i < n; i++) matched.push_back(start + sel[i]);
+        start += batch.size;
+        batch.size = 0;
+    };
+    for (const Row& r : rows) {
+        batch.push(r.date, r.category, r.income, r.amount, 0, &r.description, &r);
+        if (batch.full()) flush();
+    }
+    flush();
+    return matched;
+}
+
+static bool contains(const std::string& text, const std::string& needle) {
+    return query_detail::lower(text).find(needle) != std::string::npos;
+}
+
+static int day(int d, int m, int y) {
+    return Date(d, m, y).toDayNumber();
+}
+
+static void matchesNaiveFilter() {
+    const std::vector<Row> rows = makeRows();
+    const struct {
+        const char* text;
+        std::function<bool(const Row&)> naive;
+    } cases[] = {
+        {"", [](const Row&) { return true; }},
+        {"amount > 500 and category = Food", [](const Row& r) { return r.amount > 500 && r.category == 0; }},
+        {"not type = income or amount <= 100", [](const Row& r) { return !r.income || r.amount <= 100; }},
+        {"category in (Food, rent) and not date < 2024-03-01",
+         [](const Row& r) { return (r.category == 0 || r.category == 1) && r.date.toDayNumber() >= day(1, 3, 2024); }},
+        {"description contains COF or year = 2024", [](const Row& r) { return contains(r.description, "cof") || r.date.year == 2024; }},
+        {"(amount >= 100 and amount < 200) or (category != Rent and type = expense and date <= 31/12/2023)",
+         [](const Row& r) {
+             return (r.amount >= 100 && r.amount < 200) ||
+                    (r.category != 1 && !r.income && r.date.toDayNumber() <= day(31, 12, 2023));
+         }},
+        {"not (category in (Food, Travel) or description = 'bus fare')",
+         [](const Row& r) { return !(r.category == 0 || r.category == 2 || r.description == "Bus fare"); }},
+        {"amount in (10, 250.5) or date = 2024-02-29",
+         [](const Row& r) { return r.amount == 10 || r.amount == 250.5 || r.date.toDayNumber() == day(29, 2, 2024); }},
+        {"year != 2024 and not not amount > 900", [](const Row& r) { return r.date.year != 2024 && r.amount > 900; }},
+        {"description != Salary and type in (income) and amount < 0", [](const Row&) { return false; }},
+        {"date > 2024-06-30 and date < 2024-01-01", [](const Row&) { return false; }},
+    };
+    for (const auto& c : cases) {
+        Query query;
+        std::string error;
+        CHECK(query.compile(c.text, categoryOf, error));
+        QueryResult result;
+        std::vector<size_t> got = run(query, rows, result);
+        std::vector<size_t> expected;
+        QueryTotals totals;
+        for (size_t i = 0; i < rows.size(); i++) {
+            if (!c.naive(rows[i])) continue;
+            expected.push_back(i);
+            totals.count++;
+            (rows[i].income ? totals.income : totals.expense) += rows[i].amount;
+        }
+        bool same = got == expected;
+        CHECK(same);
+        if (!same) std::fprintf(stderr, "  %s: %zu rows, expected %zu\n", c.text, got.size(), expected.size());
+        CHECK(result.total.count == totals.count);
+        CHECK_NEAR(result.total.income, totals.income);
+        CHECK_NEAR(result.total.expense, totals.expense);
+    }
+}
+
+static void groupsAndBounds() {
+    const std::vector<Row> rows = makeRows();
+    Query query;
+    std::string error;
+    CHECK(query.compile("where category = travel and date >= 2024-01-01 and date <= 30/6/2024 group by month",
+                        categoryOf, error));
+    CHECK(query.groupKey() == GroupKey::MONTH);
+    CHECK(query.fromDay() == day(1, 1, 2024));
+    CHECK(query.toDay() == day(30, 6, 2024));
+    QueryResult result;
+    run(query, rows, result);
+    std::map<int64_t, QueryTotals> expected;
+    for (const Row& r : rows) {
+        int d = r.date.toDayNumber();
+        if (r.category != 2 || d < day(1, 1, 2024) || d > day(30, 6, 2024)) continue;
+        QueryTotals& t = expected[r.date.monthIndex()];
+        t.count++;
+        (r.income ? t.income : t.expense) += r.amount;
+    }
+    CHECK(result.key == GroupKey::MONTH);
+    CHECK(result.groups.size() == expected.size());
+    for (const auto& entry : expected) {
+        auto it = result.groups.find(entry.first);
+        CHECK(it != result.groups.end());
+        if (it == result.groups.end()) continue;
+        CHECK(it->second.count == entry.second.count);
+        CHECK_NEAR(it->second.income, entry.second.income);
+        CHECK_NEAR(it->second.expense, entry.second.expense);
+    }
+
+    // Only an "and" of date conditions narrows the dates to read
+    CHECK(query.compile("date >= 2024-01-01 or amount > 5", categoryOf, error));
+    CHECK(query.fromDay() == INT_MIN && query.toDay() == INT_MAX);
+    CHECK(query.compile("group by type", categoryOf, error));
+    CHECK(query.groupKey() == GroupKey::TYPE);
+}
+
+static void parseErrors() {
+    const char* bad[] = {
+        "amount >", "amount 5", "banana = 1", "amount > abc", "amount > 5 and", "amount > 5 or or amount < 2",
+        "(amount > 5", "amount > 5)", "category = Unknown", "category > Food", "category in Food",
+        "category in (Food, )", "category in (Food", "type = transfer", "date = 2024-02-30", "date < 1/13/2024",
+        "description > abc", "amount contains 5", "description contains", "not", "group by", "group month",
+        "group by banana", "amount > 5 group by month extra", "amount > inf", "year = 2024.5x",
+    };
+    Query query;
+    std::string error;
+    CHECK(query.compile("category = Food group by category", categoryOf, error));
+    for (const char* text : bad) {
+        error.clear();
+        bool ok = query.compile(text, categoryOf, error);
+        CHECK(!ok);
+        CHECK(!error.empty());
+        if (ok) std::fprintf(stderr, "  accepted \"%s\"\n", text);
+    }
+    // A failed compile leaves the query as it was
+    CHECK(query.groupKey() == GroupKey::CATEGORY);
+
+    error.clear();
+    query.compile("category = Unknown", categoryOf, error);
+    CHECK(error == "unknown category \"Unknown\"");
+}
+
+int main() {
+    matchesNaiveFilter();
+    groupsAndBounds();
+    parseErrors();
+    return finish("query");
+}
@@ -0,0 +1,96 @@
+#include <cstdio>
+#include "check.h"
+#include "segment_store.h"
+
+typedef std::vector<int> Segment;
+
+// Year 2000 + n holds 100 rows; year 1 holds 1000
+static Segment loadYear(int year) {
+    return Segment(year == 1 ? 1000 : 100, year);
+}
+
+static void leastRecentlyUsed() {
+    SegmentCache<Segment> cache(loadYear, 250);
+    CHECK(cache.get(2020)->front() == 2020);
+    cache.get(2021);
+    CHECK(cache.residentCount() == 2 && cache.residentRowCount() == 200);
+
+    // A third segment goes over the budget and evicts the oldest
+    std::shared_ptr<const Segment> held = cache.get(2020);
+    cache.get(2021);
+    cache.get(2022);
+    CHECK(cache.residentCount() == 2);
+    CHECK(cache.loadCount() == 3);
+    cache.get(2021);
+    CHECK(cache.loadCount() == 3);
+    // The evicted segment stays valid for whoever still holds it
+    CHECK(held->size() == 100 && held->back() == 2020);
+    cache.get(2020);
+    CHECK(cache.loadCount() == 4);
+    cache.get(2021);
+    CHECK(cache.loadCount() == 4);
+    cache.get(2022);
+    CHECK(cache.loadCount() == 5);
+
+    // A segment bigger than the budget is kept until the next one arrives
+    CHECK(cache.get(1)->size() == 1000);
+    CHECK(cache.residentCount() == 1 && cache.residentRowCount() == 1000);
+    cache.get(2020);
+    CHECK(cache.residentCount() == 1 && cache.residentRowCount() == 100);
+
+    cache.invalidate(2020);
+    CHECK(cache.residentCount() == 0 && cache.residentRowCount() == 0);
+    cache.get(2020);
+    CHECK(cache.loadCount() == 8);
+    cache.setBudget(1000);
+    cache.get(2021);
+    cache.get(2022);
+    CHECK(cache.residentCount() == 3);
+    cache.setBudget(100);
+    CHECK(cache.residentCount() == 1 && cache.getBudget() == 100);
+    cache.clear();
+    CHECK(cache.residentCount() == 0 && cache.residentRowCount() == 0);
+}
+
+static void summaries() {
+    const int CATEGORIES = 3;
+    SummaryIndex index(CATEGORIES);
+    index.setRates(0x1234abcdULL);
+    index.at(2019).add(1, 1500.25, -1);
+    index.at(2019).add(1, -200.5, 2);
+    index.at(2019).add(12, -99.99, 0);
+    index.at(2021).add(6, -10, 1);
+    CHECK(index.find(2020) == nullptr);
+    CHECK(index.find(2019)->count == 3);
+    CHECK_NEAR(index.find(2019)->net(1), 1299.75);
+    CHECK_NEAR(index.find(2019)->netTotal(), 1199.76);
+    CHECK_NEAR(index.find(2019)->spend[0 * CATEGORIES + 2], 200.5);
+
+    const char* path = "test_segment_store.segidx";
+    CHECK(index.saveToFile(path));
+    SummaryIndex loaded(CATEGORIES);
+    CHECK(loaded.loadFromFile(path));
+    CHECK(loaded.getRates() == 0x1234abcdULL);
+    CHECK(loaded.getYears().size() == 2);
+    for (const auto& entry : index.getYears()) {
+        const SegmentSummary* s = loaded.find(entry.first);
+        CHECK(s != nullptr);
+        if (!s) continue;
+        CHECK(s->count == entry.second.count);
+        CHECK(s->income == entry.second.income);
+        CHECK(s->expense == entry.second.expense);
+        CHECK(s->spend == entry.second.spend);
+    }
+    // Summaries with another category count are not used
+    SummaryIndex other(CATEGORIES + 1);
+    CHECK(!other.loadFromFile(path));
+    std::remove(path);
+    CHECK(!loaded.loadFromFile(path));
+    CHECK(loaded.getYears().empty());
+}
+
+int main() {
+    leastRecentlyUsed();
+    summaries();
+    return finish("segment_store");
+}